@@ -0,0 +1,92 @@
+#include "../util.h"
+#include "../game_object.h"
+#include "../game_space.h"
+#include "../aabb_batch.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+using namespace std;
+
+// Runs func until max_calls or a time budget of 0.2s is used up. Returns nanoseconds per call.
+double time_per_call(const function<void()>& func, int max_calls = 100000) {
+    const long long budget_ns = 200000000;
+    long long elapsed_ns = 0;
+    int calls = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    while (calls < max_calls && elapsed_ns < budget_ns) {
+        func();
+        calls++;
+        elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+    return (double)elapsed_ns / calls;
+}
+
+size_t count_hits(const vector<uint64_t>& hits, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        count += is_aabb_hit(hits.data(), i);
+    }
+    return count;
+}
+
+// Cost of testing one box against n boxes, with HitBox::intersects one pair at a time, and with each
+// find_aabb_overlaps kernel the CPU supports. Every method must find the same number of hits.
+int main() {
+    const int box_counts[] = { 10, 100, 1000, 10000 };
+    const AabbKernel kernels[] = { AabbKernel::Scalar, AabbKernel::SSE2, AabbKernel::AVX2 };
+
+    cout << "Dispatched kernel: " << get_aabb_kernel() << endl;
+    cout << "method, boxes, ns/box, hits" << endl;
+    for (int num_boxes : box_counts) {
+        srand(num_boxes);
+        EntityStore entities;
+        vector<AcceleratingObject*> objects;
+        vector<HitBox> hitboxes;
+        for (int i = 0; i < num_boxes; i++) {
+            Position position(rand() % (int)MAX_X, rand() % (int)MAX_Y);
+            AcceleratingObject* object = new AcceleratingObject(position, rand() % 7 + 1, rand() % 5 + 1);
+            objects.push_back(object);
+            entities.add(object);
+            hitboxes.push_back(object->get_hitbox());
+        }
+        vector<double> min_x, min_y, max_x, max_y;
+        for (int i = 0; i < num_boxes; i++) {
+            min_x.push_back(entities.get_min_x(i));
+            min_y.push_back(entities.get_min_y(i));
+            max_x.push_back(entities.get_max_x(i));
+            max_y.push_back(entities.get_max_y(i));
+        }
+        AabbBatch batch = { min_x.data(), min_y.data(), max_x.data(), max_y.data(), (size_t)num_boxes };
+        vector<uint64_t> hits(get_aabb_mask_words(num_boxes));
+
+        // The query box is the first one, so it always hits itself (HitBox::intersects skips itself
+        // by address, so test a copy)
+        HitBox query = hitboxes[0];
+        Aabb query_box = { min_x[0], min_y[0], max_x[0], max_y[0] };
+
+        size_t hitbox_hits = 0;
+        double hitbox_ns = time_per_call([&]() {
+            hitbox_hits = 0;
+            for (const HitBox& hitbox : hitboxes) {
+                hitbox_hits += query.intersects(hitbox);
+            }
+        });
+        cout << "HitBox::intersects, " << num_boxes << ", " << hitbox_ns / num_boxes << ", " << hitbox_hits << endl;
+
+        for (AabbKernel kernel : kernels) {
+            if (!is_aabb_kernel_supported(kernel)) {
+                cout << kernel << ", " << num_boxes << ", unsupported" << endl;
+                continue;
+            }
+            double kernel_ns = time_per_call([&]() { find_aabb_overlaps(kernel, query_box, batch, hits.data()); });
+            size_t kernel_hits = count_hits(hits, num_boxes);
+            cout << kernel << ", " << num_boxes << ", " << kernel_ns / num_boxes << ", " << kernel_hits
+                << (kernel_hits != hitbox_hits ? " (MISMATCH)" : "") << endl;
+        }
+
+        for (AcceleratingObject* object : objects) {
+            delete object;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "../util.h"
+#include "../game_object.h"
+#include "../game_space.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+using namespace std;
+
+// Runs func until max_ticks or a time budget of 0.5s is used up. Returns microseconds per call.
+double time_per_tick(const function<void()>& func, int max_ticks = 1000) {
+    const long long budget_ns = 500000000;
+    long long elapsed_ns = 0;
+    int ticks = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    while (ticks < max_ticks && elapsed_ns < budget_ns) {
+        func();
+        ticks++;
+        elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+    return elapsed_ns / 1000.0 / ticks;
+}
+
+enum class Distribution {
+    Uniform, // over the whole space
+    Floor,   // piled in the bottom 5 rows, like Hard mode sessions
+};
+
+// Number of pairs whose hitboxes actually overlap. Should be the same for every broadphase.
+size_t count_overlapping_pairs(const EntityStore& entities, const vector<CandidatePair>& pairs) {
+    size_t overlapping = 0;
+    for (const CandidatePair& candidate : pairs) {
+        if (entities.get_object(candidate.a)->intersects(entities.get_object(candidate.b))) {
+            overlapping++;
+        }
+    }
+    return overlapping;
+}
+
+// Per-tick cost of CollisionDetection against the number of entities, for each broadphase:
+// the broadphase alone (update + find pairs), and the full update (broadphase + narrowphase).
+// Entities have random sizes, like spawned falling objects.
+int main() {
+    const int entity_counts[] = { 10, 50, 100, 250, 500, 1000 };
+    const BroadphaseType broadphase_types[] = { BroadphaseType::UniformGrid, BroadphaseType::LooseQuadtree, BroadphaseType::SweepAndPrune, BroadphaseType::SpatialHash };
+    const Distribution distributions[] = { Distribution::Uniform, Distribution::Floor };
+
+    cout << "distribution, broadphase, entities, broadphase us/tick, update us/tick, candidate pairs, unique pairs, overlapping pairs" << endl;
+    for (Distribution distribution : distributions) {
+        for (int num_entities : entity_counts) {
+            srand(num_entities);
+            EntityStore entities;
+            vector<AcceleratingObject*> objects;
+            for (int i = 0; i < num_entities; i++) {
+                int y = distribution == Distribution::Uniform ? rand() % (int)MAX_Y : MAX_Y - 1 - rand() % 5;
+                Position position(rand() % (int)MAX_X, y);
+                AcceleratingObject* object = new AcceleratingObject(position, rand() % 7 + 1, rand() % 5 + 1);
+                object->set_id(i + 1);
+                objects.push_back(object);
+                entities.add(object);
+            }
+
+            for (BroadphaseType broadphase_type : broadphase_types) {
+                CollisionDetection collision_detector(broadphase_type);
+                collision_detector.find_pairs(entities); // warm up buffers
+                size_t candidate_pairs = collision_detector.get_num_candidate_pairs();
+                size_t unique_pairs = collision_detector.get_pairs().size();
+                size_t overlapping_pairs = count_overlapping_pairs(entities, collision_detector.get_pairs());
+
+                double broadphase_us = time_per_tick([&]() { collision_detector.find_pairs(entities); });
+                double update_us = time_per_tick([&]() { collision_detector.update(entities); });
+                cout << (distribution == Distribution::Uniform ? "uniform" : "floor") << ", " << broadphase_type << ", " << num_entities << ", "
+                    << broadphase_us << ", " << update_us << ", " << candidate_pairs << ", " << unique_pairs << ", " << overlapping_pairs << endl;
+            }
+
+            for (AcceleratingObject* object : objects) {
+                delete object;
+            }
+        }
+    }
+}
@@ -0,0 +1,325 @@
+#include "../util.h"
+#include "../game_object.h"
+#include "../game_space.h"
+#include "../rng.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <new>
+using namespace std;
+
+// Microbenchmarks of the math, hitbox and collision primitives, over entity counts and distributions.
+// Runs without a terminal. Build with optimisations for meaningful numbers: make bench OPTFLAGS=-O2
+//
+// Usage: Tests/bench_micro [--json] [--filter=substring] [--max-entities=N] [--repetitions=N]
+//
+// Every case is timed over --repetitions runs (5 by default) of at least MIN_RUN_NS each, after a
+// warm up run. ns/op is the median run, and the spread (max - min over the median) tells how stable it
+// was. allocs/op counts the calls to operator new during the timed runs.
+
+// Counted by the replaced operator new, on every thread
+atomic<unsigned long long> num_allocations(0);
+
+void* operator new(size_t size)
+{
+    num_allocations.fetch_add(1, memory_order_relaxed);
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+constexpr long long MIN_RUN_NS = 20000000;
+
+enum class Distribution {
+    Uniform,   // over the whole space
+    Clustered, // around a few points, like objects piling up where they land
+};
+
+const char* get_distribution_name(Distribution distribution)
+{
+    return distribution == Distribution::Uniform ? "uniform" : "clustered";
+}
+
+struct BenchResult {
+    string name;
+    Distribution distribution;
+    int entities;
+    double ns_per_op;  // median of the runs
+    double min_ns_per_op, max_ns_per_op;
+    double allocs_per_op;
+    long long ops;     // per run
+};
+
+struct BenchOptions {
+    bool json = false;
+    string filter;
+    int max_entities = 100000;
+    int repetitions = 5;
+};
+
+// Runs op, doubling the number of calls until a run lasts MIN_RUN_NS, then times options.repetitions runs of that many calls.
+BenchResult run_bench(const string& name, Distribution distribution, int entities, const BenchOptions& options, const function<void()>& op)
+{
+    long long ops = 1;
+    while (true) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long long i = 0; i < ops; i++) {
+            op();
+        }
+        long long elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        if (elapsed_ns >= MIN_RUN_NS) {
+            break;
+        }
+        ops *= 2;
+    }
+
+    vector<double> run_ns_per_op;
+    // Allocated up front, so only the operations are counted
+    run_ns_per_op.reserve(options.repetitions);
+    unsigned long long allocations_before = num_allocations.load();
+    for (int run = 0; run < options.repetitions; run++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long long i = 0; i < ops; i++) {
+            op();
+        }
+        long long elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        run_ns_per_op.push_back((double)elapsed_ns / ops);
+    }
+    unsigned long long allocations = num_allocations.load() - allocations_before;
+
+    sort(run_ns_per_op.begin(), run_ns_per_op.end());
+    BenchResult result;
+    result.name = name;
+    result.distribution = distribution;
+    result.entities = entities;
+    result.ns_per_op = run_ns_per_op[run_ns_per_op.size() / 2];
+    result.min_ns_per_op = run_ns_per_op.front();
+    result.max_ns_per_op = run_ns_per_op.back();
+    result.allocs_per_op = (double)allocations / (ops * options.repetitions);
+    result.ops = ops;
+    return result;
+}
+
+// Entities with random sizes, like spawned falling objects, owned by the scene.
+struct Scene {
+    EntityStore entities;
+    vector<AcceleratingObject*> objects;
+
+    Scene(int num_entities, Distribution distribution, uint64_t seed)
+    {
+        Pcg32 rng(seed);
+        const int num_clusters = 4;
+        const int cluster_radius = 6;
+        Position centers[num_clusters];
+        for (Position& center : centers) {
+            center = Position(rng.next_below(MAX_X), rng.next_below(MAX_Y));
+        }
+        for (int i = 0; i < num_entities; i++) {
+            Position position;
+            if (distribution == Distribution::Uniform) {
+                position = Position(rng.next_double() * MAX_X, rng.next_double() * MAX_Y);
+            } else {
+                const Position& center = centers[i % num_clusters];
+                position = bound_to_space(center + Position((rng.next_double() * 2 - 1) * cluster_radius, (rng.next_double() * 2 - 1) * cluster_radius), WorldSize());
+            }
+            AcceleratingObject* object = new AcceleratingObject(position, rng.next_below(7) + 1, rng.next_below(5) + 1);
+            object->set_id(i + 1);
+            objects.push_back(object);
+            entities.add(object);
+        }
+    }
+
+    ~Scene()
+    {
+        for (AcceleratingObject* object : objects) {
+            delete object;
+        }
+    }
+};
+
+bool parse_args(int argc, char* argv[], BenchOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--json") {
+            options.json = true;
+        } else if (arg.compare(0, 9, "--filter=") == 0) {
+            options.filter = arg.substr(9);
+        } else if (arg.compare(0, 15, "--max-entities=") == 0) {
+            options.max_entities = atoi(arg.c_str() + 15);
+        } else if (arg.compare(0, 14, "--repetitions=") == 0) {
+            options.repetitions = max(1, atoi(arg.c_str() + 14));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_table_row(const BenchResult& result)
+{
+    cout << left << setw(42) << result.name << setw(11) << get_distribution_name(result.distribution) << right << fixed << setprecision(1)
+        << setw(9) << result.entities << setw(14) << result.ns_per_op << setw(11) << result.ns_per_op / result.entities
+        << setw(9) << 100 * (result.max_ns_per_op - result.min_ns_per_op) / result.ns_per_op << "%" << setw(11) << setprecision(2) << result.allocs_per_op << endl;
+}
+
+void print_json(const vector<BenchResult>& results, const BenchOptions& options)
+{
+    cout << "{" << endl;
+    cout << "  \"repetitions\": " << options.repetitions << "," << endl;
+    cout << "  \"min_run_ns\": " << MIN_RUN_NS << "," << endl;
+    cout << "  \"aabb_kernel\": \"" << get_aabb_kernel() << "\"," << endl;
+    cout << "  \"cases\": [" << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        cout << "    {\"name\": \"" << result.name << "\", \"distribution\": \"" << get_distribution_name(result.distribution)
+            << "\", \"entities\": " << result.entities << ", \"ns_per_op\": " << result.ns_per_op
+            << ", \"min_ns_per_op\": " << result.min_ns_per_op << ", \"max_ns_per_op\": " << result.max_ns_per_op
+            << ", \"ns_per_entity\": " << result.ns_per_op / result.entities << ", \"allocs_per_op\": " << result.allocs_per_op
+            << ", \"ops_per_run\": " << result.ops << "}" << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    cout << "  ]" << endl;
+    cout << "}" << endl;
+}
+
+// Keeps results alive, so the compiler cannot drop the work that computes them
+volatile double sink;
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parse_args(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " [--json] [--filter=substring] [--max-entities=N] [--repetitions=N]" << endl;
+        return 1;
+    }
+    const int entity_counts[] = { 10, 100, 1000, 10000, 100000 };
+    const Distribution distributions[] = { Distribution::Uniform, Distribution::Clustered };
+    const BroadphaseType broadphase_types[] = { BroadphaseType::UniformGrid, BroadphaseType::LooseQuadtree, BroadphaseType::SweepAndPrune, BroadphaseType::SpatialHash };
+    // Pairs grow with the square of the entities sharing a cell (and the space is only MAX_X by MAX_Y, so
+    // they get crowded), so these stop earlier: past them, an op takes seconds
+    const int max_cell_entities = 1000;
+    const int max_update_entities[] = { 10000, 1000 }; // uniform, clustered
+
+    vector<BenchResult> results;
+    auto add_case = [&](const string& name, Distribution distribution, int entities, const function<void()>& op) {
+        if (name.find(options.filter) == string::npos) {
+            return;
+        }
+        BenchResult result = run_bench(name, distribution, entities, options, op);
+        if (!options.json) {
+            print_table_row(result);
+        }
+        results.push_back(result);
+    };
+
+    if (!options.json) {
+        cout << "Dispatched AABB kernel: " << get_aabb_kernel() << endl;
+        cout << left << setw(42) << "case" << setw(11) << "dist" << right << setw(9) << "entities" << setw(14) << "ns/op"
+            << setw(11) << "ns/entity" << setw(10) << "spread" << setw(11) << "allocs/op" << endl;
+    }
+    for (Distribution distribution : distributions) {
+        for (int num_entities : entity_counts) {
+            if (num_entities > options.max_entities) {
+                continue;
+            }
+            Scene scene(num_entities, distribution, num_entities);
+            const vector<GameObject*>& objects = scene.entities.get_objects();
+
+            // Vector2: one semi-implicit Euler step per entity
+            vector<Vector2> positions, velocities;
+            for (GameObject* object : objects) {
+                positions.push_back(object->get_position());
+                velocities.push_back(Vector2(1, -2));
+            }
+            add_case("Vector2 euler step", distribution, num_entities, [&]() {
+                const real dt = 1.0 / 60;
+                for (size_t i = 0; i < positions.size(); i++) {
+                    velocities[i] += GRAVITY * dt;
+                    positions[i] += velocities[i] * dt;
+                }
+                sink = positions[0].getX();
+            });
+            add_case("Vector2 normalise dot", distribution, num_entities, [&]() {
+                real total = 0;
+                for (size_t i = 0; i < positions.size(); i++) {
+                    total += (positions[i] + Vector2(1, 1)).normalise().dot(velocities[i]);
+                }
+                sink = total;
+            });
+
+            // One query against every entity
+            vector<Rect> rects;
+            for (GameObject* object : objects) {
+                const Aabb& bounds = object->get_hitbox().get_bounds();
+                rects.push_back(Rect(Vector2(bounds.min_x, bounds.max_y), Vector2(bounds.max_x, bounds.max_y),
+                    Vector2(bounds.min_x, bounds.min_y), Vector2(bounds.max_x, bounds.min_y)));
+            }
+            add_case("Rect::proportion_intersected", distribution, num_entities, [&]() {
+                float total = 0;
+                for (const Rect& rect : rects) {
+                    total += rects[0].proportion_intersected(rect);
+                }
+                sink = total;
+            });
+            // A copy, as HitBox::intersects skips the hitbox itself by address
+            HitBox query = objects[0]->get_hitbox();
+            add_case("HitBox::intersects", distribution, num_entities, [&]() {
+                size_t hits = 0;
+                for (GameObject* object : objects) {
+                    hits += query.intersects(object->get_hitbox());
+                }
+                sink = hits;
+            });
+
+            // Every entity in one cell
+            if (num_entities <= max_cell_entities) {
+                vector<unsigned int> cell_entities;
+                for (int i = 0; i < num_entities; i++) {
+                    cell_entities.push_back(i);
+                }
+                vector<CellSpan> spans(num_entities, CellSpan { 0, 0, 0, 0 });
+                CollisionCell cell;
+                cell.set_entities(cell_entities.data(), num_entities);
+                vector<CandidatePair> pairs;
+                add_case("CollisionCell::find_pairs", distribution, num_entities, [&]() {
+                    pairs.clear();
+                    cell.find_pairs(spans, pairs);
+                    sink = pairs.size();
+                });
+            }
+
+            if (num_entities <= max_update_entities[static_cast<int>(distribution)]) {
+                for (BroadphaseType broadphase_type : broadphase_types) {
+                    CollisionDetection collision_detector(broadphase_type);
+                    collision_detector.update(scene.entities); // warm up buffers and contacts
+                    ostringstream name;
+                    name << "CollisionDetection::update " << broadphase_type;
+                    add_case(name.str(), distribution, num_entities, [&]() {
+                        collision_detector.update(scene.entities);
+                    });
+                }
+            }
+        }
+    }
+    if (options.json) {
+        print_json(results, options);
+    }
+    return 0;
+}
@@ -0,0 +1,419 @@
+#include "../util.h"
+#include "../game_object.h"
+#include "../game_space.h"
+#include "../rng.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <new>
+
+#if defined(__APPLE__) || defined(LINUX)
+#include <sys/wait.h>
+#include <unistd.h>
+#define SCENARIO_FORK
+#endif
+
+using namespace std;
+
+// Whole engine scenarios, played headless from fixed seeds through GameSpace, compared against a baseline.
+// Build with optimisations, as the baseline was: make bench OPTFLAGS=-O2
+//
+// Usage: Tests/bench_scenarios [--baseline=path] [--update-baseline] [--tolerance=percent] [--filter=substring]
+//
+// Every scenario reports the p50, p95, p99 and max of its tick times (one GameSpace::update of
+// PHYSICS_TICK_TIME each) and the peak of the heap in use while it ran. Without --update-baseline, the
+// p50, p99 and peak heap are compared with the baseline file (Tests/scenario_baseline.txt by default),
+// and the runner fails if any is more than --tolerance percent (25 by default) above it. The max is only
+// reported: a single tick is too noisy to compare. Stress scenarios also fail if more entities (in
+// chunks or not) than their budget are ever alive.
+//
+// Tick times depend on the machine, so the baseline must be recorded (--update-baseline) on the machine
+// that checks it. The peak heap does not: it is how far the heap grew above what was in use when the
+// scenario started. Where fork() is available, every scenario runs in a process of its own, so it does not
+// reuse the object pools and buffers grown by the scenarios before, and measures the same on its own
+// (--filter) as in the whole suite.
+
+// Bytes allocated with operator new and not yet deleted, and the most there were since reset_peak_heap(),
+// when there were scenario_start_heap_bytes.
+// Every allocation is prefixed with its size, so delete knows how much is freed.
+atomic<long long> heap_bytes(0);
+atomic<long long> peak_heap_bytes(0);
+long long scenario_start_heap_bytes = 0;
+constexpr size_t ALLOCATION_HEADER = 16; // keeps the allocations aligned like malloc's
+
+void* operator new(size_t size)
+{
+    char* pointer = static_cast<char*>(malloc(size + ALLOCATION_HEADER));
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(pointer) = size;
+    long long bytes = heap_bytes.fetch_add(size, memory_order_relaxed) + size;
+    long long peak = peak_heap_bytes.load(memory_order_relaxed);
+    while (bytes > peak && !peak_heap_bytes.compare_exchange_weak(peak, bytes, memory_order_relaxed)) {
+    }
+    return pointer + ALLOCATION_HEADER;
+}
+
+void release_allocation(void* pointer)
+{
+    if (pointer == nullptr) {
+        return;
+    }
+    // Through an integer, as GCC cannot tell the header is the start of a malloc'd block (-Wmismatched-new-delete)
+    char* allocation = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(pointer) - ALLOCATION_HEADER);
+    heap_bytes.fetch_sub(*reinterpret_cast<size_t*>(allocation), memory_order_relaxed);
+    free(allocation);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    release_allocation(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    release_allocation(pointer);
+}
+
+void reset_peak_heap()
+{
+    scenario_start_heap_bytes = heap_bytes.load();
+    peak_heap_bytes.store(scenario_start_heap_bytes);
+}
+
+constexpr uint64_t SCENARIO_SEED = 1;
+constexpr long TICKS_PER_SECOND = 1000000 / PHYSICS_TICK_TIME;
+
+struct Scenario {
+    string name;
+    Difficulty difficulty;
+    long ticks;
+    // Adds the scenario's own entities to the space after it is reset (nothing if null).
+    function<void(GameSpace&)> setup;
+    // The view by default. Large worlds are played with the hash broadphase, the grid only covering the view.
+    WorldConfig world;
+    // Of Difficulty::Stress, whose scenarios fail if more entities than its budget are ever alive
+    StressConfig stress;
+};
+
+struct ScenarioResult {
+    string name;
+    long ticks;
+    double p50_us, p95_us, p99_us, max_us;
+    long long peak_heap_kb; // above the heap in use at the start
+    int peak_entities;
+    uint64_t state_hash;
+};
+
+struct ScenarioOptions {
+    string baseline_path = "Tests/scenario_baseline.txt";
+    bool update_baseline = false;
+    double tolerance = 25; // percent
+    string filter;
+};
+
+// Piles count still objects in the bottom rows of the space, like a Hard session where objects land.
+void add_floor_pile(GameSpace& game_space, int count)
+{
+    Pcg32 rng(SCENARIO_SEED, 1);
+    for (int i = 0; i < count; i++) {
+        int size_x = rng.next_below(5) + 1, size_y = rng.next_below(3) + 1;
+        Position position(rng.next_below((int)MAX_X - size_x), MAX_Y - 1 - rng.next_below(5));
+        game_space.instantiate<AcceleratingObject>(position, size_x, size_y);
+    }
+}
+
+// Spawns count falling objects at once, along the top of the space.
+void add_burst(GameSpace& game_space, int count)
+{
+    Pcg32 rng(SCENARIO_SEED, 2);
+    for (int i = 0; i < count; i++) {
+        SpawnParams params;
+        params.pos_x = rng.next_below((int)MAX_X);
+        params.size_x = rng.next_below(7) + 1;
+        params.size_y = rng.next_below(5) + 1;
+        params.acceleration_x = (rng.next_double() - 0.5) * 2;
+        params.acceleration_y = 0;
+        params.velocity_y = rng.next_double() * 4;
+        game_space.spawn_falling_obj(params);
+    }
+}
+
+// Scatters count drifting objects over the whole world, most of them far from the player.
+void add_scattered(GameSpace& game_space, int count)
+{
+    Pcg32 rng(SCENARIO_SEED, 3);
+    const WorldSize& world = game_space.get_world_size();
+    for (int i = 0; i < count; i++) {
+        int size_x = rng.next_below(5) + 1, size_y = rng.next_below(3) + 1;
+        Position position(rng.next_double() * (world.width - size_x), rng.next_double() * (world.height - size_y));
+        Vector2 velocity((rng.next_double() - 0.5) * 4, (rng.next_double() - 0.5) * 4);
+        game_space.instantiate<AcceleratingObject>(position, size_x, size_y, false, Vector2(0, 0), velocity);
+    }
+}
+
+WorldConfig get_large_world()
+{
+    WorldConfig world;
+    world.width = 6400;
+    world.height = 6400;
+    return world;
+}
+
+// Rain on a small budget: in a large world, the objects falling out of the active chunks must still
+// count against it, and go once out of the simulated ones.
+StressConfig get_small_budget()
+{
+    StressConfig stress;
+    stress.max_entities = 500;
+    return stress;
+}
+
+vector<Scenario> get_scenarios()
+{
+    return {
+        // Steady rain: a full round of each difficulty
+        { "rain_easy", Difficulty::Easy, (long)Difficulty::Easy * TICKS_PER_SECOND, nullptr },
+        { "rain_medium", Difficulty::Medium, (long)Difficulty::Medium * TICKS_PER_SECOND, nullptr },
+        { "rain_hard", Difficulty::Hard, (long)Difficulty::Hard * TICKS_PER_SECOND, nullptr },
+        { "floor_pile", Difficulty::Hard, 10 * TICKS_PER_SECOND, [](GameSpace& game_space) { add_floor_pile(game_space, 1000); } },
+        { "burst_5000", Difficulty::Medium, 5 * TICKS_PER_SECOND, [](GameSpace& game_space) { add_burst(game_space, 5000); } },
+        // Rounds are played one after the other, like the headless driver does
+        { "long_session", Difficulty::Medium, 10 * 60 * TICKS_PER_SECOND, nullptr },
+        // 4096 views' worth of world. Only the chunks around the player are simulated, so it should tick
+        // about as fast as rain_medium, whatever is out there.
+        { "large_world", Difficulty::Medium, 30 * TICKS_PER_SECOND, [](GameSpace& game_space) { add_scattered(game_space, 20000); }, get_large_world() },
+        { "large_world_stress", Difficulty::Stress, 60 * TICKS_PER_SECOND, nullptr, get_large_world(), get_small_budget() },
+    };
+}
+
+ScenarioResult run_scenario(const Scenario& scenario)
+{
+    GameSpace* game_space = GameSpace::get_instance();
+    game_space->set_seed(SCENARIO_SEED);
+    game_space->set_world(scenario.world);
+    game_space->set_stress_config(scenario.stress);
+    game_space->set_broadphase(scenario.world.is_large() ? BroadphaseType::SpatialHash : BroadphaseType::UniformGrid);
+    // test mode keeps the player alive, so a round only ends when the game timer runs out
+    game_space->reset(scenario.difficulty, true);
+    game_space->reset_update_stats();
+    reset_peak_heap();
+    if (scenario.setup) {
+        scenario.setup(*game_space);
+    }
+
+    LatencyHistogram tick_times;
+    int peak_entities = 0;
+    for (long i = 0; i < scenario.ticks; i++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool game_over = game_space->update(PHYSICS_TICK_TIME);
+        tick_times.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        peak_entities = max(peak_entities, game_space->get_num_of_entities());
+        if (game_over) {
+            game_space->reset(scenario.difficulty, true);
+        }
+    }
+
+    ScenarioResult result;
+    result.name = scenario.name;
+    result.ticks = scenario.ticks;
+    result.p50_us = tick_times.get_percentile(50) / 1000.0;
+    result.p95_us = tick_times.get_percentile(95) / 1000.0;
+    result.p99_us = tick_times.get_percentile(99) / 1000.0;
+    result.max_us = tick_times.get_max() / 1000.0;
+    result.peak_heap_kb = (peak_heap_bytes.load() - scenario_start_heap_bytes) / 1024;
+    result.peak_entities = peak_entities;
+    result.state_hash = game_space->get_state_hash();
+    return result;
+}
+
+// Runs scenario in a child process, which sends its result back through a pipe. Runs it in this process
+// where fork() is not available. Returns false if the child failed.
+bool run_isolated(const Scenario& scenario, ScenarioResult& result)
+{
+#ifdef SCENARIO_FORK
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    // Or the child would write what is buffered again
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        ScenarioResult child_result = run_scenario(scenario);
+        ostringstream line;
+        line << setprecision(17) << child_result.p50_us << " " << child_result.p95_us << " " << child_result.p99_us << " "
+            << child_result.max_us << " " << child_result.peak_heap_kb << " " << child_result.peak_entities << " " << child_result.state_hash;
+        string text = line.str();
+        bool written = write(fds[1], text.data(), text.size()) == (ssize_t)text.size();
+        close(fds[1]);
+        _exit(written ? 0 : 1);
+    }
+    close(fds[1]);
+    string text;
+    char buffer[256];
+    ssize_t count;
+    while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, count);
+    }
+    close(fds[0]);
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return false;
+    }
+    result.name = scenario.name;
+    result.ticks = scenario.ticks;
+    istringstream fields(text);
+    return static_cast<bool>(fields >> result.p50_us >> result.p95_us >> result.p99_us >> result.max_us
+        >> result.peak_heap_kb >> result.peak_entities >> result.state_hash);
+#else
+    result = run_scenario(scenario);
+    return true;
+#endif
+}
+
+// A baseline is a line per scenario: name p50_us p95_us p99_us max_us peak_heap_kb. Lines starting with # are comments.
+bool read_baseline(const string& path, map<string, ScenarioResult>& baseline)
+{
+    ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        istringstream fields(line);
+        ScenarioResult result = ScenarioResult();
+        if (fields >> result.name >> result.p50_us >> result.p95_us >> result.p99_us >> result.max_us >> result.peak_heap_kb) {
+            baseline[result.name] = result;
+        }
+    }
+    return true;
+}
+
+bool write_baseline(const string& path, const vector<ScenarioResult>& results)
+{
+    ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << "# Baseline of Tests/bench_scenarios (make bench OPTFLAGS=-O2). Regenerate with --update-baseline." << endl;
+    out << "# name p50_us p95_us p99_us max_us peak_heap_kb" << endl;
+    out << fixed << setprecision(1);
+    for (const ScenarioResult& result : results) {
+        out << result.name << " " << result.p50_us << " " << result.p95_us << " " << result.p99_us << " "
+            << result.max_us << " " << result.peak_heap_kb << endl;
+    }
+    return true;
+}
+
+// Prints how value compares with baseline_value. Returns false if it is more than tolerance percent above it.
+bool check_metric(const string& scenario, const string& metric, double value, double baseline_value, double tolerance)
+{
+    double change = baseline_value > 0 ? 100 * (value - baseline_value) / baseline_value : 0;
+    bool regressed = change > tolerance;
+    cout << "  " << left << setw(20) << scenario << setw(13) << metric << right << fixed << setprecision(1)
+        << setw(12) << value << " vs " << setw(12) << baseline_value << showpos << setw(9) << change << "%" << noshowpos
+        << (regressed ? "  REGRESSION" : "") << endl;
+    return !regressed;
+}
+
+bool parse_args(int argc, char* argv[], ScenarioOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 11, "--baseline=") == 0) {
+            options.baseline_path = arg.substr(11);
+        } else if (arg == "--update-baseline") {
+            options.update_baseline = true;
+        } else if (arg.compare(0, 12, "--tolerance=") == 0) {
+            options.tolerance = atof(arg.c_str() + 12);
+        } else if (arg.compare(0, 9, "--filter=") == 0) {
+            options.filter = arg.substr(9);
+        } else {
+            return false;
+        }
+    }
+    return options.tolerance >= 0;
+}
+
+int main(int argc, char* argv[]) {
+    ScenarioOptions options;
+    if (!parse_args(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " [--baseline=path] [--update-baseline] [--tolerance=percent] [--filter=substring]" << endl;
+        return 1;
+    }
+
+    vector<ScenarioResult> results;
+    vector<string> over_budget;
+    cout << left << setw(20) << "scenario" << right << setw(8) << "ticks" << setw(10) << "p50 us" << setw(10) << "p95 us"
+        << setw(10) << "p99 us" << setw(11) << "max us" << setw(11) << "heap KiB" << setw(10) << "entities" << "  state hash" << endl;
+    for (const Scenario& scenario : get_scenarios()) {
+        if (scenario.name.find(options.filter) == string::npos) {
+            continue;
+        }
+        ScenarioResult result;
+        if (!run_isolated(scenario, result)) {
+            cerr << "Scenario " << scenario.name << " failed" << endl;
+            return 1;
+        }
+        cout << left << setw(20) << result.name << right << setw(8) << result.ticks << fixed << setprecision(1)
+            << setw(10) << result.p50_us << setw(10) << result.p95_us << setw(10) << result.p99_us << setw(11) << result.max_us
+            << setw(11) << result.peak_heap_kb << setw(10) << result.peak_entities << "  " << hex << result.state_hash << dec << endl;
+        results.push_back(result);
+        if (scenario.difficulty == Difficulty::Stress && result.peak_entities > (int)scenario.stress.max_entities) {
+            over_budget.push_back(scenario.name + ": " + to_string(result.peak_entities) + " entities, over the budget of "
+                + to_string(scenario.stress.max_entities));
+        }
+    }
+    for (const string& message : over_budget) {
+        cout << "  " << message << endl;
+    }
+
+    if (options.update_baseline) {
+        if (!write_baseline(options.baseline_path, results)) {
+            cerr << "Could not write " << options.baseline_path << endl;
+            return 1;
+        }
+        cout << "Baseline written to " << options.baseline_path << endl;
+        return over_budget.empty() ? 0 : 1;
+    }
+
+    map<string, ScenarioResult> baseline;
+    if (!read_baseline(options.baseline_path, baseline)) {
+        cerr << "Could not read baseline " << options.baseline_path << endl;
+        return 1;
+    }
+    cout << "Against " << options.baseline_path << " (tolerance " << options.tolerance << "%):" << endl;
+    bool passed = over_budget.empty();
+    for (const ScenarioResult& result : results) {
+        map<string, ScenarioResult>::const_iterator it = baseline.find(result.name);
+        if (it == baseline.end()) {
+            cout << "  " << result.name << ": not in the baseline" << endl;
+            continue;
+        }
+        const ScenarioResult& expected = it->second;
+        passed &= check_metric(result.name, "p50 us", result.p50_us, expected.p50_us, options.tolerance);
+        passed &= check_metric(result.name, "p99 us", result.p99_us, expected.p99_us, options.tolerance);
+        passed &= check_metric(result.name, "heap KiB", result.peak_heap_kb, expected.peak_heap_kb, options.tolerance);
+    }
+    cout << (passed ? "PASS" : "FAIL") << endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#include "../util.h"
+#include "../game_object.h"
+#include <iostream>
+#include "../game_space.h"
+using namespace std;
+
+int main() {
+    GameSpace gamespace;
+    // fobj1 falls 30 units in one tick, from above fobj2 to below it: more than the 8 substeps can catch,
+    // as each still moves further than the 3x3 hitboxes
+    AcceleratingObject* fobj1 = gamespace.test_spawn_falling_obj(Position(10, 5), Vector2(0, 30 * MILLION / PHYSICS_TICK_TIME));
+    AcceleratingObject* fobj2 = gamespace.test_spawn_falling_obj(Position(10, 15));
+
+    gamespace.update(PHYSICS_TICK_TIME);
+    // The GameSpace only writes the motion of falling objects back to them when they collide, so their
+    // velocities are those after their last collision
+    cout << "fobj1 stopped (pushed back by fobj2)" << endl;
+    cout << boolalpha << (fobj1->get_velocity().getY() < 100) << endl;
+
+    cout << endl << "fobj2 hit (pushed down by fobj1)" << endl;
+    cout << boolalpha << (fobj2->get_velocity().getY() > 100) << endl;
+    cout << "Swept impacts: " << gamespace.get_update_stats().impacts << endl;
+}
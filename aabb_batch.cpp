@@ -0,0 +1,113 @@
+#include "aabb_batch.h"
+#include <algorithm>
+
+// The SIMD kernels are compiled with target attributes rather than -msse2/-mavx2, so the rest of the
+// game still runs on CPUs without AVX2 and the kernel is picked at run time.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AABB_BATCH_X86
+#include <immintrin.h>
+#endif
+
+std::ostream& operator<<(std::ostream& os, const AabbKernel& kernel)
+{
+    switch (kernel) {
+        case AabbKernel::Scalar:
+            os << "scalar";
+            break;
+        case AabbKernel::SSE2:
+            os << "sse2";
+            break;
+        case AabbKernel::AVX2:
+            os << "avx2";
+            break;
+    }
+    return os;
+}
+
+// Tests boxes [begin, batch.size) one at a time. Only sets bits, hits must be cleared beforehand.
+static void find_overlaps_scalar(const Aabb& box, const AabbBatch& batch, size_t begin, uint64_t* hits)
+{
+    for (size_t i = begin; i < batch.size; i++) {
+        Aabb other = { batch.min_x[i], batch.min_y[i], batch.max_x[i], batch.max_y[i] };
+        hits[i / 64] |= static_cast<uint64_t>(aabbs_overlap(box, other)) << (i % 64);
+    }
+}
+
+#ifdef AABB_BATCH_X86
+__attribute__((target("sse2")))
+static void find_overlaps_sse2(const Aabb& box, const AabbBatch& batch, uint64_t* hits)
+{
+    const __m128d min_x = _mm_set1_pd(box.min_x), min_y = _mm_set1_pd(box.min_y);
+    const __m128d max_x = _mm_set1_pd(box.max_x), max_y = _mm_set1_pd(box.max_y);
+    size_t i = 0;
+    for (; i + 2 <= batch.size; i += 2) {
+        __m128d hit = _mm_and_pd(_mm_cmple_pd(min_x, _mm_loadu_pd(batch.max_x + i)), _mm_cmpge_pd(max_x, _mm_loadu_pd(batch.min_x + i)));
+        hit = _mm_and_pd(hit, _mm_cmpge_pd(max_y, _mm_loadu_pd(batch.min_y + i)));
+        hit = _mm_and_pd(hit, _mm_cmple_pd(min_y, _mm_loadu_pd(batch.max_y + i)));
+        // i is even, so the 2 bits never straddle two words
+        hits[i / 64] |= static_cast<uint64_t>(_mm_movemask_pd(hit)) << (i % 64);
+    }
+    find_overlaps_scalar(box, batch, i, hits);
+}
+
+__attribute__((target("avx2")))
+static void find_overlaps_avx2(const Aabb& box, const AabbBatch& batch, uint64_t* hits)
+{
+    const __m256d min_x = _mm256_set1_pd(box.min_x), min_y = _mm256_set1_pd(box.min_y);
+    const __m256d max_x = _mm256_set1_pd(box.max_x), max_y = _mm256_set1_pd(box.max_y);
+    size_t i = 0;
+    for (; i + 4 <= batch.size; i += 4) {
+        __m256d hit = _mm256_and_pd(_mm256_cmp_pd(min_x, _mm256_loadu_pd(batch.max_x + i), _CMP_LE_OQ),
+            _mm256_cmp_pd(max_x, _mm256_loadu_pd(batch.min_x + i), _CMP_GE_OQ));
+        hit = _mm256_and_pd(hit, _mm256_cmp_pd(max_y, _mm256_loadu_pd(batch.min_y + i), _CMP_GE_OQ));
+        hit = _mm256_and_pd(hit, _mm256_cmp_pd(min_y, _mm256_loadu_pd(batch.max_y + i), _CMP_LE_OQ));
+        // i is a multiple of 4, so the 4 bits never straddle two words
+        hits[i / 64] |= static_cast<uint64_t>(_mm256_movemask_pd(hit)) << (i % 64);
+    }
+    find_overlaps_scalar(box, batch, i, hits);
+}
+#endif
+
+bool is_aabb_kernel_supported(AabbKernel kernel)
+{
+    switch (kernel) {
+        case AabbKernel::Scalar:
+            return true;
+#ifdef AABB_BATCH_X86
+        case AabbKernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case AabbKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+AabbKernel get_aabb_kernel()
+{
+    static const AabbKernel kernel = is_aabb_kernel_supported(AabbKernel::AVX2) ? AabbKernel::AVX2
+        : is_aabb_kernel_supported(AabbKernel::SSE2) ? AabbKernel::SSE2 : AabbKernel::Scalar;
+    return kernel;
+}
+
+void find_aabb_overlaps(const Aabb& box, const AabbBatch& batch, uint64_t* hits)
+{
+    find_aabb_overlaps(get_aabb_kernel(), box, batch, hits);
+}
+
+void find_aabb_overlaps(AabbKernel kernel, const Aabb& box, const AabbBatch& batch, uint64_t* hits)
+{
+    std::fill(hits, hits + get_aabb_mask_words(batch.size), 0);
+#ifdef AABB_BATCH_X86
+    if (kernel == AabbKernel::AVX2 && is_aabb_kernel_supported(AabbKernel::AVX2)) {
+        find_overlaps_avx2(box, batch, hits);
+        return;
+    }
+    if (kernel == AabbKernel::SSE2 && is_aabb_kernel_supported(AabbKernel::SSE2)) {
+        find_overlaps_sse2(box, batch, hits);
+        return;
+    }
+#endif
+    find_overlaps_scalar(box, batch, 0, hits);
+}
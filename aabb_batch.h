@@ -0,0 +1,48 @@
+#pragma once
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include "util.h"
+
+// Bounds of a batch of boxes, packed one array per bound so they can be loaded several at a time.
+struct AabbBatch {
+    const double* min_x;
+    const double* min_y;
+    const double* max_x;
+    const double* max_y;
+    size_t size;
+};
+
+enum class AabbKernel {
+    Scalar,
+    SSE2, // 2 boxes at a time
+    AVX2, // 4 boxes at a time
+};
+
+std::ostream& operator<<(std::ostream& os, const AabbKernel& kernel);
+
+// Returns the number of 64 bit words in the hit mask of a batch of size boxes.
+inline size_t get_aabb_mask_words(size_t size)
+{
+    return (size + 63) / 64;
+}
+
+// Returns true if bit index of a hit mask is set.
+inline bool is_aabb_hit(const uint64_t* hits, size_t index)
+{
+    return (hits[index / 64] >> (index % 64)) & 1;
+}
+
+// Returns true if the CPU can run kernel. Scalar is always supported.
+bool is_aabb_kernel_supported(AabbKernel kernel);
+
+// Returns the widest kernel the CPU supports, checked once.
+AabbKernel get_aabb_kernel();
+
+// Tests box against every box of batch, with the same (inclusive) edges as HitBox::intersects, and sets
+// bit i of hits if it overlaps box i. hits must hold get_aabb_mask_words(batch.size) words.
+// Uses get_aabb_kernel().
+void find_aabb_overlaps(const Aabb& box, const AabbBatch& batch, uint64_t* hits);
+
+// Same, with the given kernel. Falls back to the scalar one if the CPU does not support it.
+void find_aabb_overlaps(AabbKernel kernel, const Aabb& box, const AabbBatch& batch, uint64_t* hits);
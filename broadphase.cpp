@@ -0,0 +1,581 @@
+#include "broadphase.h"
+
+std::ostream& operator<<(std::ostream& os, const BroadphaseType& type)
+{
+    switch (type) {
+        case BroadphaseType::UniformGrid:
+            os << "UniformGrid";
+            break;
+        case BroadphaseType::LooseQuadtree:
+            os << "LooseQuadtree";
+            break;
+        case BroadphaseType::SweepAndPrune:
+            os << "SweepAndPrune";
+            break;
+        case BroadphaseType::SpatialHash:
+            os << "SpatialHash";
+            break;
+    }
+    return os;
+}
+
+bool parse_broadphase_type(const std::string& name, BroadphaseType& type)
+{
+    if (name == "grid") {
+        type = BroadphaseType::UniformGrid;
+        return true;
+    }
+    if (name == "quadtree") {
+        type = BroadphaseType::LooseQuadtree;
+        return true;
+    }
+    if (name == "sap") {
+        type = BroadphaseType::SweepAndPrune;
+        return true;
+    }
+    if (name == "hash") {
+        type = BroadphaseType::SpatialHash;
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<Broadphase> Broadphase::create(BroadphaseType type, const WorldSize& world)
+{
+    switch (type) {
+        case BroadphaseType::LooseQuadtree:
+            return std::unique_ptr<Broadphase>(new LooseQuadtreeBroadphase(world));
+        case BroadphaseType::SweepAndPrune:
+            return std::unique_ptr<Broadphase>(new SweepAndPruneBroadphase());
+        case BroadphaseType::SpatialHash:
+            return std::unique_ptr<Broadphase>(new SpatialHashBroadphase());
+        case BroadphaseType::UniformGrid:
+        default:
+            return std::unique_ptr<Broadphase>(new UniformGridBroadphase());
+    }
+}
+
+CollisionCell::CollisionCell(int x, int y): x(x), y(y) {
+}
+
+void CollisionCell::setX(int x) {
+    this->x = x;
+}
+void CollisionCell::setY(int y) {
+    this->y = y;
+}
+int CollisionCell::getX() const {
+    return x;
+}
+int CollisionCell::getY() const {
+    return y;
+}
+
+void CollisionCell::clear_entities()
+{
+    entities = nullptr;
+    num_entities = 0;
+}
+
+void CollisionCell::set_entities(const unsigned int* entities, int num_entities)
+{
+    this->entities = entities;
+    this->num_entities = num_entities;
+}
+
+void CollisionCell::find_pairs(const std::vector<CellSpan>& entity_spans, std::vector<CandidatePair>& pairs) const
+{
+    // entities are in ascending order, so a < b in every pair
+    for (int i = 0; i < num_entities; i++) {
+        const CellSpan& span = entity_spans[entities[i]];
+        for (int j = i + 1; j < num_entities; j++) {
+            const CellSpan& other_span = entity_spans[entities[j]];
+            if (std::max(span.min_x, other_span.min_x) != x || std::max(span.min_y, other_span.min_y) != y) {
+                continue; // already found in an earlier cell
+            }
+            pairs.push_back(CandidatePair { entities[i], entities[j], 0 });
+        }
+    }
+}
+
+int CollisionCell::get_num_of_entities() const
+{
+    return num_entities;
+}
+
+UniformGridBroadphase::UniformGridBroadphase()
+{
+    for (size_t i = 0; i < COLLISION_GRID_Y; i++) { // i = y = rows
+        for (size_t j = 0; j < COLLISION_GRID_X; j++) { // j = x = cols
+            cells[i][j].setX(j);
+            cells[i][j].setY(i);
+        }
+    }
+}
+
+void UniformGridBroadphase::clear_cells()
+{
+    for (size_t i = 0; i < COLLISION_GRID_Y; i++) { // i = y = rows
+        for (size_t j = 0; j < COLLISION_GRID_X; j++) { // j = x = cols
+            cells[i][j].clear_entities();
+        }
+    }
+}
+
+CellSpan UniformGridBroadphase::get_cell_span(const EntityStore& entities, size_t index)
+{
+    // Clamped to the grid, so entities partly (or fully) outside the space use the border cells
+    auto to_cell = [](double coordinate, size_t grid_size) {
+        int cell = static_cast<int>(std::floor(coordinate / COLLISION_DIVISION));
+        return std::min(std::max(cell, 0), static_cast<int>(grid_size) - 1);
+    };
+    return CellSpan {
+        to_cell(entities.get_min_x(index), COLLISION_GRID_X),
+        to_cell(entities.get_min_y(index), COLLISION_GRID_Y),
+        to_cell(entities.get_max_x(index), COLLISION_GRID_X),
+        to_cell(entities.get_max_y(index), COLLISION_GRID_Y)
+    };
+}
+
+void UniformGridBroadphase::update(const EntityStore& entities)
+{
+    clear_cells();
+
+    // Count how many entities each cell gets. An entity goes in every cell its hitbox spans.
+    cell_offsets.fill(0);
+    entity_spans.resize(entities.size());
+    size_t num_insertions = 0;
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (!entities.has_flag(i, ENTITY_COLLIDABLE)) {
+            entity_spans[i] = CellSpan { 0, 0, -1, -1 }; // empty span
+            continue;
+        }
+        CellSpan span = get_cell_span(entities, i);
+        entity_spans[i] = span;
+        for (int y = span.min_y; y <= span.max_y; y++) {
+            for (int x = span.min_x; x <= span.max_x; x++) {
+                cell_offsets[y * COLLISION_GRID_X + x + 1]++;
+            }
+        }
+        num_insertions += (span.max_x - span.min_x + 1) * (span.max_y - span.min_y + 1);
+    }
+
+    // Prefix sum of the counts gives where each cell starts in cell_entities
+    for (size_t cell = 1; cell <= COLLISION_GRID_CELLS; cell++) {
+        cell_offsets[cell] += cell_offsets[cell - 1];
+    }
+    cell_entities.resize(num_insertions);
+    for (size_t i = 0; i < COLLISION_GRID_Y; i++) {
+        for (size_t j = 0; j < COLLISION_GRID_X; j++) {
+            size_t cell = i * COLLISION_GRID_X + j;
+            cells[i][j].set_entities(cell_entities.data() + cell_offsets[cell], cell_offsets[cell + 1] - cell_offsets[cell]);
+        }
+    }
+
+    // Scatter. cell_offsets[cell] is used as the insertion cursor, so it ends up at the end of the cell.
+    for (size_t i = 0; i < entities.size(); i++) {
+        const CellSpan& span = entity_spans[i];
+        for (int y = span.min_y; y <= span.max_y; y++) {
+            for (int x = span.min_x; x <= span.max_x; x++) {
+                cell_entities[cell_offsets[y * COLLISION_GRID_X + x]++] = i;
+            }
+        }
+    }
+}
+
+void UniformGridBroadphase::find_pairs(std::vector<CandidatePair>& pairs) const
+{
+    for (size_t i = 0; i < COLLISION_GRID_Y; i++) { // i = y = rows
+        for (size_t j = 0; j < COLLISION_GRID_X; j++) { // j = x = cols
+            cells[i][j].find_pairs(entity_spans, pairs);
+        }
+    }
+}
+
+BroadphaseType UniformGridBroadphase::get_type() const
+{
+    return BroadphaseType::UniformGrid;
+}
+
+void UniformGridBroadphase::print(RenderSnapshot& snapshot) const
+{
+    for (size_t i = 0; i < COLLISION_GRID_Y; i++) {
+        for (size_t j = 0; j < COLLISION_GRID_X; j++) {
+            snapshot.add_label(i*COLLISION_DIVISION, j*COLLISION_DIVISION, std::to_string(cells[i][j].get_num_of_entities()));
+        }
+    }
+}
+
+void SpatialHashBroadphase::update(const EntityStore& entities)
+{
+    cell_of_key.clear();
+    cells.clear();
+    cell_offsets.clear();
+    insertion_cells.clear();
+
+    // Count how many entities each cell gets, creating the cells as they are first touched
+    entity_spans.resize(entities.size());
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (!entities.has_flag(i, ENTITY_COLLIDABLE)) {
+            entity_spans[i] = CellSpan { 0, 0, -1, -1 }; // empty span
+            continue;
+        }
+        CellSpan span = {
+            static_cast<int>(std::floor(entities.get_min_x(i) / COLLISION_DIVISION)),
+            static_cast<int>(std::floor(entities.get_min_y(i) / COLLISION_DIVISION)),
+            static_cast<int>(std::floor(entities.get_max_x(i) / COLLISION_DIVISION)),
+            static_cast<int>(std::floor(entities.get_max_y(i) / COLLISION_DIVISION))
+        };
+        entity_spans[i] = span;
+        for (int y = span.min_y; y <= span.max_y; y++) {
+            for (int x = span.min_x; x <= span.max_x; x++) {
+                unsigned int& cell = cell_of_key.insert(get_cell_key(x, y), cells.size());
+                if (cell == cells.size()) {
+                    cells.push_back(CollisionCell(x, y));
+                    cell_offsets.push_back(0);
+                }
+                cell_offsets[cell]++;
+                insertion_cells.push_back(cell);
+            }
+        }
+    }
+
+    // Exclusive prefix sum of the counts gives where each cell starts in cell_entities
+    int offset = 0;
+    for (int& cell_offset : cell_offsets) {
+        int count = cell_offset;
+        cell_offset = offset;
+        offset += count;
+    }
+    cell_offsets.push_back(offset);
+    cell_entities.resize(insertion_cells.size());
+    for (size_t cell = 0; cell < cells.size(); cell++) {
+        cells[cell].set_entities(cell_entities.data() + cell_offsets[cell], cell_offsets[cell + 1] - cell_offsets[cell]);
+    }
+
+    // Scatter, in the same order as the count, so insertion_cells gives each insertion's cell.
+    // cell_offsets[cell] is used as the insertion cursor.
+    size_t insertion = 0;
+    for (size_t i = 0; i < entities.size(); i++) {
+        const CellSpan& span = entity_spans[i];
+        for (int y = span.min_y; y <= span.max_y; y++) {
+            for (int x = span.min_x; x <= span.max_x; x++) {
+                cell_entities[cell_offsets[insertion_cells[insertion++]]++] = i;
+            }
+        }
+    }
+}
+
+void SpatialHashBroadphase::find_pairs(std::vector<CandidatePair>& pairs) const
+{
+    for (const CollisionCell& cell : cells) {
+        cell.find_pairs(entity_spans, pairs);
+    }
+}
+
+BroadphaseType SpatialHashBroadphase::get_type() const
+{
+    return BroadphaseType::SpatialHash;
+}
+
+void SpatialHashBroadphase::print(RenderSnapshot& snapshot) const
+{
+    // Cells are in world coordinates, which the view may not start at, so only their number is shown
+    std::string hash_str = "Hash cells: " + std::to_string(cells.size()) + ", insertions: " + std::to_string(cell_entities.size());
+    snapshot.add_label(1, 1, hash_str);
+}
+
+size_t SpatialHashBroadphase::get_num_of_cells() const
+{
+    return cells.size();
+}
+
+LooseQuadtreeBroadphase::LooseQuadtreeBroadphase(const WorldSize& world) : world(world)
+{
+    nodes.reserve(64);
+}
+
+int LooseQuadtreeBroadphase::get_child_for(const Node& node, int entity) const
+{
+    double child_half_size = node.half_size / 2;
+    double half_extent = std::max(max_x[entity] - min_x[entity], max_y[entity] - min_y[entity]) / 2;
+    if (half_extent > child_half_size) {
+        return -1;
+    }
+    double center_x = (min_x[entity] + max_x[entity]) / 2;
+    double center_y = (min_y[entity] + max_y[entity]) / 2;
+    // Only possible at the root: entities outside the space stay there
+    if (std::abs(center_x - node.center_x) > node.half_size || std::abs(center_y - node.center_y) > node.half_size) {
+        return -1;
+    }
+    int quadrant = (center_x >= node.center_x ? 1 : 0) + (center_y >= node.center_y ? 2 : 0);
+    return node.first_child + quadrant;
+}
+
+bool LooseQuadtreeBroadphase::loose_bounds_overlap(const Node& node, int entity) const
+{
+    double loose_half_size = node.half_size * 2;
+    return min_x[entity] <= node.center_x + loose_half_size && max_x[entity] >= node.center_x - loose_half_size &&
+        min_y[entity] <= node.center_y + loose_half_size && max_y[entity] >= node.center_y - loose_half_size;
+}
+
+void LooseQuadtreeBroadphase::split(int node_index)
+{
+    int first_child = nodes.size();
+    {
+        Node& node = nodes[node_index];
+        node.first_child = first_child;
+        double child_half_size = node.half_size / 2;
+        for (int quadrant = 0; quadrant < 4; quadrant++) {
+            Node child {
+                node.center_x + (quadrant & 1 ? child_half_size : -child_half_size),
+                node.center_y + (quadrant & 2 ? child_half_size : -child_half_size),
+                child_half_size, -1, -1, 0, node.depth + 1
+            };
+            nodes.push_back(child); // may invalidate node
+        }
+    }
+
+    // Move the entities that fit into a child
+    Node& node = nodes[node_index];
+    int entity = node.first_entity;
+    node.first_entity = -1;
+    node.num_entities = 0;
+    while (entity != -1) {
+        int next = next_entity[entity];
+        int child = get_child_for(node, entity);
+        Node& target = child == -1 ? node : nodes[child];
+        next_entity[entity] = target.first_entity;
+        target.first_entity = entity;
+        target.num_entities++;
+        entity = next;
+    }
+
+    for (int child = first_child; child < first_child + 4; child++) {
+        if (nodes[child].num_entities > QUADTREE_NODE_CAPACITY && nodes[child].depth < QUADTREE_MAX_DEPTH) {
+            split(child);
+        }
+    }
+}
+
+void LooseQuadtreeBroadphase::insert(int entity)
+{
+    int node_index = 0;
+    while (true) {
+        Node& node = nodes[node_index];
+        int child = node.first_child == -1 ? -1 : get_child_for(node, entity);
+        if (child != -1) {
+            node_index = child;
+            continue;
+        }
+        next_entity[entity] = node.first_entity;
+        node.first_entity = entity;
+        node.num_entities++;
+        if (node.first_child == -1 && node.num_entities > QUADTREE_NODE_CAPACITY && node.depth < QUADTREE_MAX_DEPTH) {
+            split(node_index);
+        }
+        return;
+    }
+}
+
+void LooseQuadtreeBroadphase::update(const EntityStore& entities)
+{
+    size_t num_entities = entities.size();
+    next_entity.assign(num_entities, -1);
+    min_x.resize(num_entities); min_y.resize(num_entities);
+    max_x.resize(num_entities); max_y.resize(num_entities);
+
+    nodes.clear();
+    double half_size = std::max(world.width, world.height) / 2;
+    nodes.push_back(Node { world.width / 2, world.height / 2, half_size, -1, -1, 0, 0 });
+
+    for (size_t i = 0; i < num_entities; i++) {
+        if (!entities.has_flag(i, ENTITY_COLLIDABLE)) {
+            continue;
+        }
+        min_x[i] = entities.get_min_x(i); min_y[i] = entities.get_min_y(i);
+        max_x[i] = entities.get_max_x(i); max_y[i] = entities.get_max_y(i);
+        insert(i);
+    }
+}
+
+void LooseQuadtreeBroadphase::find_pairs(std::vector<CandidatePair>& pairs) const
+{
+    // Every entity queries the tree. An entity's hitbox is inside the loose bounds of its node,
+    // so nodes whose loose bounds it does not overlap can be skipped. Each overlapping pair is
+    // found from both sides, so only the one from the lower index is kept.
+    for (const Node& entity_node : nodes) {
+        for (int entity = entity_node.first_entity; entity != -1; entity = next_entity[entity]) {
+            query_stack.clear();
+            query_stack.push_back(0);
+            while (!query_stack.empty()) {
+                const Node& node = nodes[query_stack.back()];
+                query_stack.pop_back();
+                // The root is always visited, as it holds entities outside the space
+                if (&node != &nodes[0] && !loose_bounds_overlap(node, entity)) {
+                    continue;
+                }
+                for (int other = node.first_entity; other != -1; other = next_entity[other]) {
+                    if (other <= entity) {
+                        continue;
+                    }
+                    if (min_x[entity] <= max_x[other] && max_x[entity] >= min_x[other] &&
+                        min_y[entity] <= max_y[other] && max_y[entity] >= min_y[other]) {
+                        pairs.push_back(CandidatePair { static_cast<unsigned int>(entity), static_cast<unsigned int>(other), 0 });
+                    }
+                }
+                if (node.first_child != -1) {
+                    for (int child = node.first_child; child < node.first_child + 4; child++) {
+                        query_stack.push_back(child);
+                    }
+                }
+            }
+        }
+    }
+}
+
+BroadphaseType LooseQuadtreeBroadphase::get_type() const
+{
+    return BroadphaseType::LooseQuadtree;
+}
+
+void LooseQuadtreeBroadphase::print(RenderSnapshot& snapshot) const
+{
+    // Number of entities in each non-empty node, at its top left corner
+    for (const Node& node : nodes) {
+        if (node.num_entities == 0) {
+            continue;
+        }
+        int x = std::max(0.0, node.center_x - node.half_size);
+        int y = std::max(0.0, node.center_y - node.half_size);
+        snapshot.add_label(y, x, std::to_string(node.num_entities));
+    }
+}
+
+int LooseQuadtreeBroadphase::get_num_of_nodes() const
+{
+    return nodes.size();
+}
+
+void SweepAndPruneBroadphase::update(const EntityStore& entities)
+{
+    tick++;
+
+    // Refresh the proxies of existing entities, and add proxies for new ones
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (!entities.has_flag(i, ENTITY_COLLIDABLE)) {
+            continue;
+        }
+        EntityId id = entities.get_id(i);
+        unsigned int* found = proxy_of_id.find(id);
+        unsigned int proxy_index;
+        if (found != nullptr) {
+            proxy_index = *found;
+        } else {
+            if (free_proxies.empty()) {
+                proxy_index = proxies.size();
+                proxies.push_back(Proxy());
+            } else {
+                proxy_index = free_proxies.back();
+                free_proxies.pop_back();
+            }
+            proxy_of_id.insert(id, proxy_index);
+            // New endpoints go at the end, insertion sort moves them into place
+            endpoints.push_back(Endpoint { 0, proxy_index, true });
+            endpoints.push_back(Endpoint { 0, proxy_index, false });
+        }
+        Proxy& proxy = proxies[proxy_index];
+        proxy.id = id;
+        proxy.index = i;
+        proxy.min_x = entities.get_min_x(i);
+        proxy.max_x = entities.get_max_x(i);
+        proxy.min_y = entities.get_min_y(i);
+        proxy.max_y = entities.get_max_y(i);
+        proxy.stamp = tick;
+        proxy.in_use = true;
+    }
+
+    // Remove proxies of entities that were deleted or are no longer collidable
+    bool removed = false;
+    for (unsigned int proxy_index = 0; proxy_index < proxies.size(); proxy_index++) {
+        Proxy& proxy = proxies[proxy_index];
+        if (proxy.in_use && proxy.stamp != tick) {
+            proxy.in_use = false;
+            proxy_of_id.erase(proxy.id);
+            free_proxies.push_back(proxy_index);
+            removed = true;
+        }
+    }
+    if (removed) {
+        endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+            [this](const Endpoint& endpoint) { return !proxies[endpoint.proxy].in_use; }), endpoints.end());
+    }
+
+    for (Endpoint& endpoint : endpoints) {
+        const Proxy& proxy = proxies[endpoint.proxy];
+        endpoint.value = endpoint.is_min ? proxy.min_x : proxy.max_x;
+    }
+    insertion_sort();
+}
+
+void SweepAndPruneBroadphase::insertion_sort()
+{
+    // At equal values, min endpoints go first, so touching hitboxes still overlap
+    auto less = [](const Endpoint& e1, const Endpoint& e2) {
+        return e1.value < e2.value || (e1.value == e2.value && e1.is_min && !e2.is_min);
+    };
+    swaps_last_update = 0;
+    for (size_t i = 1; i < endpoints.size(); i++) {
+        Endpoint endpoint = endpoints[i];
+        size_t j = i;
+        while (j > 0 && less(endpoint, endpoints[j - 1])) {
+            endpoints[j] = endpoints[j - 1];
+            j--;
+        }
+        endpoints[j] = endpoint;
+        swaps_last_update += i - j;
+    }
+}
+
+void SweepAndPruneBroadphase::find_pairs(std::vector<CandidatePair>& pairs) const
+{
+    // Sweep along x, keeping the set of hitboxes whose x interval is open. A min endpoint overlaps on x
+    // with every active hitbox, so only y needs testing.
+    active_proxies.clear();
+    active_slot.resize(proxies.size());
+    for (const Endpoint& endpoint : endpoints) {
+        const Proxy& proxy = proxies[endpoint.proxy];
+        if (!endpoint.is_min) {
+            // Swap remove from the active set
+            int slot = active_slot[endpoint.proxy];
+            active_proxies[slot] = active_proxies.back();
+            active_slot[active_proxies[slot]] = slot;
+            active_proxies.pop_back();
+            continue;
+        }
+        for (unsigned int active : active_proxies) {
+            const Proxy& other = proxies[active];
+            if (proxy.min_y <= other.max_y && proxy.max_y >= other.min_y) {
+                pairs.push_back(CandidatePair { std::min(proxy.index, other.index), std::max(proxy.index, other.index), 0 });
+            }
+        }
+        active_slot[endpoint.proxy] = active_proxies.size();
+        active_proxies.push_back(endpoint.proxy);
+    }
+}
+
+BroadphaseType SweepAndPruneBroadphase::get_type() const
+{
+    return BroadphaseType::SweepAndPrune;
+}
+
+void SweepAndPruneBroadphase::print(RenderSnapshot& snapshot) const
+{
+    std::string sap_str = "SAP endpoints: " + std::to_string(endpoints.size()) + ", swaps: " + std::to_string(swaps_last_update);
+    snapshot.add_label(1, 1, sap_str);
+}
+
+long SweepAndPruneBroadphase::get_swaps_last_update() const
+{
+    return swaps_last_update;
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <iostream>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "util.h"
+#include "entity_store.h"
+#include "flat_hash_map.h"
+#include "render_snapshot.h"
+
+// Pair of entities (indices into the EntityStore) whose hitboxes may overlap.
+struct CandidatePair {
+    unsigned int a;
+    unsigned int b;
+    // Unordered pair key over the entities' ids, filled in by CollisionDetection
+    uint64_t key;
+};
+
+// Key of the unordered pair of entities id1 and id2: the same whichever order they are given in.
+inline uint64_t get_pair_key(EntityId id1, EntityId id2)
+{
+    return id1 < id2 ? (static_cast<uint64_t>(id1) << 32) | id2 : (static_cast<uint64_t>(id2) << 32) | id1;
+}
+
+enum class BroadphaseType {
+    UniformGrid,
+    LooseQuadtree,
+    SweepAndPrune,
+    SpatialHash,
+};
+
+std::ostream& operator<<(std::ostream& os, const BroadphaseType& type);
+
+// Parses "grid", "quadtree", "sap" or "hash". Returns false if name is not a broadphase.
+bool parse_broadphase_type(const std::string& name, BroadphaseType& type);
+
+// Finds candidate pairs for CollisionDetection's narrowphase. Only collidable entities are considered.
+class Broadphase {
+    public:
+        virtual ~Broadphase() = default;
+
+        // Rebuilds the broadphase from the entities' hitbox bounds. Called once per tick.
+        virtual void update(const EntityStore& entities) = 0;
+
+        // Appends the candidate pairs found by the last update() to pairs.
+        virtual void find_pairs(std::vector<CandidatePair>& pairs) const = 0;
+
+        virtual BroadphaseType get_type() const = 0;
+
+        // Debug view, shown in test mode.
+        virtual void print(RenderSnapshot& snapshot) const = 0;
+
+        // world bounds the entities the broadphase is given.
+        static std::unique_ptr<Broadphase> create(BroadphaseType type, const WorldSize& world);
+};
+
+// Range of cells (inclusive) an entity's hitbox spans.
+struct CellSpan {
+    int min_x, min_y, max_x, max_y;
+};
+
+// A cell of the uniform grid. Does not own its entities: it is a view into the
+// flat buffer UniformGridBroadphase fills every tick.
+class CollisionCell {
+    int x;
+    int y;
+    const unsigned int* entities = nullptr;
+    int num_entities = 0;
+
+    public:
+        CollisionCell(int x = 0, int y = 0);
+        void setX(int x);
+        void setY(int y);
+        int getX() const;
+        int getY() const;
+        void clear_entities();
+        void set_entities(const unsigned int* entities, int num_entities);
+        // Appends the pairs of entities in the cell. A pair sharing several cells is only
+        // appended by the first cell they share (lowest x and y), given the entities' spans.
+        void find_pairs(const std::vector<CellSpan>& entity_spans, std::vector<CandidatePair>& pairs) const;
+
+        int get_num_of_entities() const;
+};
+
+constexpr size_t COLLISION_DIVISION = 25;
+constexpr size_t COLLISION_GRID_X = static_cast<size_t>(MAX_X) / COLLISION_DIVISION + (static_cast<size_t>(MAX_X) % COLLISION_DIVISION > 0 ? 2 : 1);
+constexpr size_t COLLISION_GRID_Y = static_cast<size_t>(MAX_Y) / COLLISION_DIVISION + (static_cast<size_t>(MAX_Y) % COLLISION_DIVISION > 0 ? 2 : 1);
+constexpr size_t COLLISION_GRID_CELLS = COLLISION_GRID_X * COLLISION_GRID_Y;
+
+// Fixed grid of COLLISION_DIVISION sized cells over the space.
+class UniformGridBroadphase : public Broadphase {
+    std::array<std::array<CollisionCell, COLLISION_GRID_X>, COLLISION_GRID_Y> cells;
+    // Counting sort of entities into cells. All buffers are kept between ticks, so after warm up
+    // building the cells does not allocate.
+    std::array<int, COLLISION_GRID_CELLS + 1> cell_offsets;
+    std::vector<CellSpan> entity_spans;
+    std::vector<unsigned int> cell_entities;
+
+    void clear_cells();
+    static CellSpan get_cell_span(const EntityStore& entities, size_t index);
+
+    public:
+        UniformGridBroadphase();
+        virtual void update(const EntityStore& entities) override;
+        virtual void find_pairs(std::vector<CandidatePair>& pairs) const override;
+        virtual BroadphaseType get_type() const override;
+        virtual void print(RenderSnapshot& snapshot) const override;
+};
+
+// Key of the cell (or chunk) at (x, y) in a FlatHashMap, which hashes it: a spatial hash.
+inline uint64_t get_cell_key(int x, int y)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+// Uniform grid of COLLISION_DIVISION sized cells that is not bounded: cells are keyed by a spatial hash
+// of their coordinates, and only those holding entities exist, so memory follows the entities instead
+// of the size of the space. UniformGridBroadphase only covers the view, so this is the grid for worlds
+// larger than it (see GameSpace::set_world).
+class SpatialHashBroadphase : public Broadphase {
+    // Cells of the last update, in the order they were first touched
+    FlatHashMap<uint64_t, unsigned int> cell_of_key;
+    std::vector<CollisionCell> cells;
+    // Counting sort of entities into cells, like UniformGridBroadphase. All buffers are kept between ticks.
+    std::vector<int> cell_offsets;
+    std::vector<unsigned int> insertion_cells; // cell of every insertion, in the order of the scatter
+    std::vector<CellSpan> entity_spans;
+    std::vector<unsigned int> cell_entities;
+
+    public:
+        virtual void update(const EntityStore& entities) override;
+        virtual void find_pairs(std::vector<CandidatePair>& pairs) const override;
+        virtual BroadphaseType get_type() const override;
+        virtual void print(RenderSnapshot& snapshot) const override;
+
+        size_t get_num_of_cells() const;
+};
+
+constexpr int QUADTREE_MAX_DEPTH = 6;
+constexpr int QUADTREE_NODE_CAPACITY = 8;
+
+// Loose quadtree over the world, rebuilt every tick. A node only splits once it holds more than QUADTREE_NODE_CAPACITY
+// entities, so the tree is deep where entities cluster (e.g. piled at the floor) and shallow elsewhere.
+// Each node's loose bounds are twice its size, so an entity is stored in the deepest node whose
+// tight bounds contain its center and whose half size is at least the entity's half extent.
+class LooseQuadtreeBroadphase : public Broadphase {
+    struct Node {
+        double center_x, center_y, half_size;
+        int first_child; // index of the first of 4 children, -1 if leaf
+        int first_entity; // head of the entity list, -1 if empty
+        int num_entities;
+        int depth;
+    };
+
+    // The root node covers it
+    WorldSize world;
+    std::vector<Node> nodes;
+    // Intrusive linked lists of entities in each node, indexed by entity index
+    std::vector<int> next_entity;
+    std::vector<double> min_x, min_y, max_x, max_y;
+    mutable std::vector<int> query_stack;
+
+    void insert(int entity);
+    void split(int node);
+    int get_child_for(const Node& node, int entity) const;
+    bool loose_bounds_overlap(const Node& node, int entity) const;
+
+    public:
+        explicit LooseQuadtreeBroadphase(const WorldSize& world);
+        virtual void update(const EntityStore& entities) override;
+        virtual void find_pairs(std::vector<CandidatePair>& pairs) const override;
+        virtual BroadphaseType get_type() const override;
+        virtual void print(RenderSnapshot& snapshot) const override;
+
+        int get_num_of_nodes() const;
+};
+
+// Sweep and prune along x. Unlike the other broadphases, it is not rebuilt every tick: the endpoint list
+// (min and max x of every hitbox) stays sorted between ticks and is re-sorted with insertion sort.
+// Falling objects mostly move along y, so their x order barely changes and sorting is close to O(n).
+class SweepAndPruneBroadphase : public Broadphase {
+    struct Proxy {
+        EntityId id;
+        unsigned int index; // in the EntityStore, refreshed every tick
+        double min_x, max_x, min_y, max_y;
+        unsigned long stamp; // tick the proxy was last seen
+        bool in_use;
+    };
+
+    struct Endpoint {
+        double value;
+        unsigned int proxy;
+        bool is_min;
+    };
+
+    std::vector<Proxy> proxies;
+    std::vector<unsigned int> free_proxies;
+    FlatHashMap<EntityId, unsigned int> proxy_of_id;
+    std::vector<Endpoint> endpoints;
+    mutable std::vector<unsigned int> active_proxies;
+    mutable std::vector<int> active_slot; // position of each proxy in active_proxies
+    unsigned long tick = 0;
+    long swaps_last_update = 0;
+
+    void insertion_sort();
+
+    public:
+        virtual void update(const EntityStore& entities) override;
+        virtual void find_pairs(std::vector<CandidatePair>& pairs) const override;
+        virtual BroadphaseType get_type() const override;
+        virtual void print(RenderSnapshot& snapshot) const override;
+
+        // Number of endpoint swaps done by insertion sort in the last update(). Low when the order is coherent.
+        long get_swaps_last_update() const;
+};
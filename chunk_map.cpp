@@ -0,0 +1,102 @@
+#include "chunk_map.h"
+#include "broadphase.h"
+#include <cstdlib>
+
+const char* const WORLD_OPTIONS_USAGE = "[--world=WIDTHxHEIGHT] [--active-radius=N] [--coarse-radius=N]";
+
+// Parses a whole number of at least min. Returns false if text is not one.
+static bool parse_at_least(const std::string& text, unsigned long min, unsigned long& value)
+{
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::strtoul(text.c_str(), nullptr, 10);
+    return value >= min;
+}
+
+bool parse_world_option(const std::string& arg, WorldConfig& config)
+{
+    unsigned long value;
+    if (arg.compare(0, 8, "--world=") == 0) {
+        std::string size = arg.substr(8);
+        size_t separator = size.find('x');
+        unsigned long width, height;
+        if (separator == std::string::npos || !parse_at_least(size.substr(0, separator), MAX_X, width)
+            || !parse_at_least(size.substr(separator + 1), MAX_Y, height) || width > WorldConfig::MAX_SIDE || height > WorldConfig::MAX_SIDE) {
+            return false;
+        }
+        config.width = width;
+        config.height = height;
+        return true;
+    }
+    // Radii are stored in a byte in replay logs
+    if (arg.compare(0, 16, "--active-radius=") == 0) {
+        if (!parse_at_least(arg.substr(16), 1, value) || value > 255) {
+            return false;
+        }
+        config.active_radius = value;
+        return true;
+    }
+    if (arg.compare(0, 16, "--coarse-radius=") == 0) {
+        if (!parse_at_least(arg.substr(16), 0, value) || value > 255) {
+            return false;
+        }
+        config.coarse_radius = value;
+        return true;
+    }
+    return false;
+}
+
+bool is_valid_world_config(const WorldConfig& config)
+{
+    return config.width >= MAX_X && config.height >= MAX_Y && config.width <= WorldConfig::MAX_SIDE && config.height <= WorldConfig::MAX_SIDE
+        && config.active_radius >= 1 && config.active_radius <= 255 && config.coarse_radius >= 0 && config.coarse_radius <= 255;
+}
+
+void ChunkMap::add(GameObject* entity)
+{
+    Position position = entity->get_position();
+    int x = get_chunk_coordinate(position.getX()), y = get_chunk_coordinate(position.getY());
+    unsigned int next_chunk = free_chunks.empty() ? chunks.size() : free_chunks.back();
+    unsigned int index = chunk_of_key.insert(get_cell_key(x, y), next_chunk);
+    if (index == next_chunk) {
+        if (free_chunks.empty()) {
+            chunks.push_back(Chunk());
+        } else {
+            free_chunks.pop_back();
+        }
+        chunks[index].x = x;
+        chunks[index].y = y;
+    }
+    chunks[index].entities.push_back(entity);
+    num_entities++;
+}
+
+void ChunkMap::take_chunk(int x, int y, std::vector<GameObject*>& out)
+{
+    uint64_t key = get_cell_key(x, y);
+    const unsigned int* index = chunk_of_key.find(key);
+    if (index == nullptr) {
+        return;
+    }
+    Chunk& chunk = chunks[*index];
+    out.insert(out.end(), chunk.entities.begin(), chunk.entities.end());
+    num_entities -= chunk.entities.size();
+    chunk.entities.clear();
+    free_chunks.push_back(*index);
+    chunk_of_key.erase(key);
+}
+
+void ChunkMap::take_all(std::vector<GameObject*>& out)
+{
+    for_each_entity([&out](GameObject* entity) {
+        out.push_back(entity);
+    });
+    for (Chunk& chunk : chunks) {
+        chunk.entities.clear();
+    }
+    chunks.clear();
+    free_chunks.clear();
+    chunk_of_key.clear();
+    num_entities = 0;
+}
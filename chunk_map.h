@@ -0,0 +1,87 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "util.h"
+#include "game_object.h"
+#include "flat_hash_map.h"
+
+// Side of a chunk. At least half the view on both axes, so the chunks around the player's always cover the view.
+constexpr int CHUNK_SIZE = 64;
+static_assert(2 * CHUNK_SIZE >= MAX_X && 2 * CHUNK_SIZE >= MAX_Y, "the active chunks must cover the view");
+
+// Chunks ticked coarsely (see WorldConfig) are simulated once every this many ticks, for that many ticks' time.
+constexpr unsigned long COARSE_TICK_INTERVAL = 16;
+
+// A world larger than the view, split into chunks of CHUNK_SIZE (see GameSpace::set_world). Radii are in
+// chunks, on either axis, from the chunk the player is in.
+struct WorldConfig {
+    static constexpr uint32_t MAX_SIDE = 999999999;
+
+    uint32_t width = MAX_X, height = MAX_Y; // up to MAX_SIDE
+    // Chunks this close are simulated every tick. At least 1.
+    int active_radius = 1;
+    // Chunks further than active_radius but this close are ticked coarsely, without collisions. Chunks
+    // further still are frozen until the player comes close again.
+    int coarse_radius = 2;
+
+    // Returns true if the world is larger than the view. Chunks are only used then.
+    bool is_large() const { return width > MAX_X || height > MAX_Y; }
+};
+
+// Parses "--world=WIDTHxHEIGHT", "--active-radius=N" or "--coarse-radius=N" into config. Returns false if arg
+// is not one of them or its value is not valid.
+bool parse_world_option(const std::string& arg, WorldConfig& config);
+
+// Returns true if every value of config is one parse_world_option accepts.
+bool is_valid_world_config(const WorldConfig& config);
+
+// Usage of the options parse_world_option takes.
+extern const char* const WORLD_OPTIONS_USAGE;
+
+// Returns the chunk coordinate of a world coordinate.
+inline int get_chunk_coordinate(double coordinate)
+{
+    return static_cast<int>(std::floor(coordinate / CHUNK_SIZE));
+}
+
+// Entities of the chunks that are not simulated every tick, keyed by a spatial hash of their chunk's
+// coordinates. Only chunks holding entities exist, so memory follows what is out there, not the size of
+// the world, and reaching a chunk is a hash lookup however many there are.
+class ChunkMap {
+    struct Chunk {
+        int x, y;
+        std::vector<GameObject*> entities;
+    };
+
+    FlatHashMap<uint64_t, unsigned int> chunk_of_key; // index into chunks
+    // Chunks emptied are kept (with their buffers) for reuse
+    std::vector<Chunk> chunks;
+    std::vector<unsigned int> free_chunks;
+    size_t num_entities = 0;
+
+    public:
+        // Adds entity to the chunk its position is in.
+        void add(GameObject* entity);
+
+        // Moves the entities of the chunk at (x, y) to the end of out, in the order they were added, and removes the chunk.
+        void take_chunk(int x, int y, std::vector<GameObject*>& out);
+
+        // Moves every entity to the end of out, and removes every chunk.
+        void take_all(std::vector<GameObject*>& out);
+
+        // Calls func(entity) for every entity. The order only depends on the order of the adds and takes.
+        template <typename F>
+        void for_each_entity(F func) const
+        {
+            for (const Chunk& chunk : chunks) {
+                for (GameObject* entity : chunk.entities) {
+                    func(entity);
+                }
+            }
+        }
+
+        size_t size() const { return num_entities; }
+        size_t get_num_of_chunks() const { return chunk_of_key.size(); }
+};
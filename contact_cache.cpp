@@ -0,0 +1,130 @@
+#include "contact_cache.h"
+#include <algorithm>
+
+std::ostream& operator<<(std::ostream& os, const ContactEventType& type)
+{
+    switch (type) {
+        case ContactEventType::Begin:
+            os << "begin";
+            break;
+        case ContactEventType::End:
+            os << "end";
+            break;
+    }
+    return os;
+}
+
+// Returns true if the contact between the entities at indices a and b should go on.
+static bool is_touching(const EntityStore& entities, size_t a, size_t b)
+{
+    if (entities.has_flag(a, ENTITY_DELETABLE) || !entities.has_flag(a, ENTITY_COLLIDABLE)
+        || entities.has_flag(b, ENTITY_DELETABLE) || !entities.has_flag(b, ENTITY_COLLIDABLE)) {
+        return false;
+    }
+    return aabbs_overlap(entities.get_bounds(a), entities.get_bounds(b));
+}
+
+// Returns the push-out of the entity at index entity away from the one at other: towards other, scaled by
+// Rect::proportion_intersected, which is negative when they overlap.
+static Vector2 get_push_out(const EntityStore& entities, size_t entity, size_t other)
+{
+    float proportion = proportion_intersected(entities.get_bounds(entity), entities.get_bounds(other));
+    Position position(entities.get_position_x(entity), entities.get_position_y(entity));
+    Position other_position(entities.get_position_x(other), entities.get_position_y(other));
+    return (other_position - position).normalise() * proportion;
+}
+
+void ContactCache::begin_tick()
+{
+    tick++;
+    events.clear();
+}
+
+bool ContactCache::contains(uint64_t key) const
+{
+    return contacts.find(key) != nullptr;
+}
+
+void ContactCache::begin_contact(uint64_t key, GameObject* a, GameObject* b)
+{
+    contacts.insert(key, Contact { a, b, tick });
+    events.push_back(ContactEvent { ContactEventType::Begin, a->get_id(), b->get_id() });
+}
+
+void ContactCache::end_separated_contacts(const EntityStore& entities)
+{
+    num_persisting = 0;
+    ended_keys.clear();
+    contacts.for_each([this, &entities](uint64_t key, const Contact& contact) {
+        if (is_touching(entities, contact.a->get_store_index(), contact.b->get_store_index())) {
+            num_persisting += contact.first_tick < tick;
+        } else {
+            ended_keys.push_back(key);
+        }
+    });
+    // Few contacts end per tick, so sorting them for the events is cheap
+    std::sort(ended_keys.begin(), ended_keys.end());
+    for (uint64_t key : ended_keys) {
+        const Contact& contact = *contacts.find(key);
+        events.push_back(ContactEvent { ContactEventType::End, contact.a->get_id(), contact.b->get_id() });
+        contacts.erase(key);
+    }
+}
+
+void ContactCache::add_push_outs(EntityStore& entities)
+{
+    // Slot order only depends on the order contacts were started and ended in, so it is the same every run
+    contacts.for_each([&entities](uint64_t, const Contact& contact) {
+        size_t a = contact.a->get_store_index(), b = contact.b->get_store_index();
+        entities.add_contact_push(a, get_push_out(entities, a, b));
+        entities.add_contact_push(b, get_push_out(entities, b, a));
+    });
+}
+
+void ContactCache::clear()
+{
+    // for_each visits every slot, so a table grown by a burst of contacts would keep slowing every tick down
+    if (contacts.get_capacity() > MAX_RETAINED_SLOTS) {
+        contacts.release();
+    } else {
+        contacts.clear();
+    }
+    events.clear();
+    num_persisting = 0;
+}
+
+void ContactCache::remove_contacts_of(const std::vector<GameObject*>& entities)
+{
+    if (contacts.size() == 0) {
+        return;
+    }
+    removed_entities.assign(entities.begin(), entities.end());
+    std::sort(removed_entities.begin(), removed_entities.end());
+    auto is_removed = [this](const GameObject* entity) {
+        return std::binary_search(removed_entities.begin(), removed_entities.end(), entity);
+    };
+    ended_keys.clear();
+    contacts.for_each([&](uint64_t key, const Contact& contact) {
+        if (is_removed(contact.a) || is_removed(contact.b)) {
+            ended_keys.push_back(key);
+        }
+    });
+    for (uint64_t key : ended_keys) {
+        contacts.erase(key);
+    }
+}
+
+size_t ContactCache::size() const
+{
+    return contacts.size();
+}
+
+size_t ContactCache::get_num_persisting() const
+{
+    return num_persisting;
+}
+
+const std::vector<ContactEvent>& ContactCache::get_events() const
+{
+    return events;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "util.h"
+#include "game_object.h"
+#include "entity_store.h"
+#include "flat_hash_map.h"
+
+enum class ContactEventType {
+    Begin,
+    End,
+};
+
+std::ostream& operator<<(std::ostream& os, const ContactEventType& type);
+
+// A pair of entities starting or ending contact.
+struct ContactEvent {
+    ContactEventType type;
+    EntityId id_a; // lower id
+    EntityId id_b;
+};
+
+// Two entities whose hitboxes are touching, since first_tick. a has the lower id.
+struct Contact {
+    GameObject* a;
+    GameObject* b;
+    unsigned long first_tick;
+};
+
+// Entities in contact, keyed by pair key (see get_pair_key), for the whole space. A pair that collided
+// stays in contact until the entities separate (or either one becomes deletable or not collidable), and
+// does not collide again while in contact: the contact pushes the entities apart instead.
+// Replaces the list of colliding entities each GameObject used to keep, so starting, checking and ending
+// a contact is O(1) instead of a scan of both entities' lists.
+class ContactCache {
+    // clear() keeps the slots of the map for the next round, up to this many
+    static constexpr size_t MAX_RETAINED_SLOTS = 4096;
+
+    FlatHashMap<uint64_t, Contact> contacts;
+    unsigned long tick = 0;
+    // Events of the current tick, in the order they happened
+    std::vector<ContactEvent> events;
+    size_t num_persisting = 0;
+    // Scratch buffer for the contacts ending in end_separated_contacts()
+    std::vector<uint64_t> ended_keys;
+    // Scratch buffer of remove_contacts_of(), sorted
+    std::vector<const GameObject*> removed_entities;
+
+    public:
+        // Starts a new tick, clearing the events of the last one.
+        void begin_tick();
+
+        // Returns true if the pair is in contact.
+        bool contains(uint64_t key) const;
+
+        // Starts a contact between a and b (a with the lower id). Emits a Begin event.
+        void begin_contact(uint64_t key, GameObject* a, GameObject* b);
+
+        // Ends the contacts whose entities are no longer touching, or either is deletable or not
+        // collidable, as entities holds them. Emits an End event for each, in key order.
+        void end_separated_contacts(const EntityStore& entities);
+
+        // Adds the push-out of every contact to both entities' contact push (see EntityStore::add_contact_push).
+        void add_push_outs(EntityStore& entities);
+
+        // Removes every contact without events, e.g. when all entities are deleted.
+        void clear();
+
+        // Removes the contacts of any of entities without events, e.g. when they leave the simulation.
+        void remove_contacts_of(const std::vector<GameObject*>& entities);
+
+        size_t size() const;
+        // Number of contacts that started before the current tick and are still going.
+        size_t get_num_persisting() const;
+        const std::vector<ContactEvent>& get_events() const;
+};
@@ -0,0 +1,209 @@
+#include "entity_store.h"
+#include <algorithm>
+
+size_t EntityStore::add(GameObject* entity)
+{
+    objects.push_back(entity);
+    ids.push_back(entity->get_id());
+    position_x.push_back(0); position_y.push_back(0);
+    velocity_x.push_back(0); velocity_y.push_back(0);
+    acceleration_x.push_back(0); acceleration_y.push_back(0);
+    push_x.push_back(0); push_y.push_back(0);
+    size_x.push_back(0); size_y.push_back(0);
+    min_x.push_back(0); min_y.push_back(0); max_x.push_back(0); max_y.push_back(0);
+    flags.push_back(0);
+    chars.push_back(' ');
+    patterns.push_back(Pattern::Cross);
+
+    size_t index = objects.size() - 1;
+    entity->set_store_index(index);
+    sync(index);
+    // A new entity has no previous tick, so it does not move between them
+    previous_position_x.push_back(position_x[index]);
+    previous_position_y.push_back(position_y[index]);
+    start_position_x.push_back(position_x[index]);
+    start_position_y.push_back(position_y[index]);
+    return index;
+}
+
+template <typename T>
+static void swap_remove(std::vector<T>& v, size_t index)
+{
+    v[index] = v.back();
+    v.pop_back();
+}
+
+void EntityStore::remove(size_t index)
+{
+    objects.back()->set_store_index(index);
+    swap_remove(objects, index);
+    swap_remove(ids, index);
+    swap_remove(position_x, index); swap_remove(position_y, index);
+    swap_remove(previous_position_x, index); swap_remove(previous_position_y, index);
+    swap_remove(start_position_x, index); swap_remove(start_position_y, index);
+    swap_remove(velocity_x, index); swap_remove(velocity_y, index);
+    swap_remove(acceleration_x, index); swap_remove(acceleration_y, index);
+    swap_remove(push_x, index); swap_remove(push_y, index);
+    swap_remove(size_x, index); swap_remove(size_y, index);
+    swap_remove(min_x, index); swap_remove(min_y, index); swap_remove(max_x, index); swap_remove(max_y, index);
+    swap_remove(flags, index);
+    swap_remove(chars, index);
+    swap_remove(patterns, index);
+}
+
+void EntityStore::clear()
+{
+    objects.clear();
+    ids.clear();
+    position_x.clear(); position_y.clear();
+    previous_position_x.clear(); previous_position_y.clear();
+    start_position_x.clear(); start_position_y.clear();
+    velocity_x.clear(); velocity_y.clear();
+    acceleration_x.clear(); acceleration_y.clear();
+    push_x.clear(); push_y.clear();
+    size_x.clear(); size_y.clear();
+    min_x.clear(); min_y.clear(); max_x.clear(); max_y.clear();
+    flags.clear();
+    chars.clear();
+    patterns.clear();
+}
+
+void EntityStore::reserve(size_t capacity)
+{
+    objects.reserve(capacity);
+    ids.reserve(capacity);
+    position_x.reserve(capacity); position_y.reserve(capacity);
+    previous_position_x.reserve(capacity); previous_position_y.reserve(capacity);
+    start_position_x.reserve(capacity); start_position_y.reserve(capacity);
+    velocity_x.reserve(capacity); velocity_y.reserve(capacity);
+    acceleration_x.reserve(capacity); acceleration_y.reserve(capacity);
+    push_x.reserve(capacity); push_y.reserve(capacity);
+    size_x.reserve(capacity); size_y.reserve(capacity);
+    min_x.reserve(capacity); min_y.reserve(capacity); max_x.reserve(capacity); max_y.reserve(capacity);
+    flags.reserve(capacity);
+    chars.reserve(capacity);
+    patterns.reserve(capacity);
+}
+
+void EntityStore::reserve_more(size_t count)
+{
+    size_t needed = objects.size() + count;
+    if (needed > objects.capacity()) {
+        reserve(std::max(needed, 2 * objects.capacity()));
+    }
+}
+
+void EntityStore::update(long step_time, const WorldSize& world)
+{
+    double time = step_time / MILLION;
+    // The contact push is per tick, so substeps each get their share of it
+    double push_share = step_time / static_cast<double>(PHYSICS_TICK_TIME);
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (flags[i] & ENTITY_OWN_MOTION) {
+            objects[i]->update(step_time, world);
+            sync(i);
+            continue;
+        }
+        velocity_x[i] += acceleration_x[i] * time;
+        velocity_y[i] += acceleration_y[i] * time;
+        if (flags[i] & ENTITY_COLLIDABLE) {
+            velocity_x[i] += push_x[i] * push_share;
+            velocity_y[i] += push_y[i] * push_share;
+        }
+        position_x[i] += velocity_x[i] * time;
+        position_y[i] += velocity_y[i] * time;
+        // Like HitBox::get_bounds
+        double half_size_x = size_x[i] / 2.0, half_size_y = size_y[i] / 2.0;
+        min_x[i] = position_x[i] - half_size_x;
+        min_y[i] = position_y[i] - half_size_y;
+        max_x[i] = position_x[i] + half_size_x;
+        max_y[i] = position_y[i] + half_size_y;
+        if (!(flags[i] & ENTITY_DELETABLE) && !is_in_bounds(get_bounds(i), world)) {
+            // Once per entity, so the GameObject is told right away
+            flags[i] |= ENTITY_DELETABLE;
+            objects[i]->set_deletable(true);
+        }
+    }
+}
+
+void EntityStore::sync(size_t index)
+{
+    GameObject* entity = objects[index];
+    Position position = entity->get_position();
+    Vector2 velocity = entity->get_velocity();
+    Vector2 acceleration = entity->get_acceleration();
+    position_x[index] = position.getX();
+    position_y[index] = position.getY();
+    velocity_x[index] = velocity.getX();
+    velocity_y[index] = velocity.getY();
+    acceleration_x[index] = acceleration.getX();
+    acceleration_y[index] = acceleration.getY();
+    size_x[index] = entity->get_size_x();
+    size_y[index] = entity->get_size_y();
+
+    const Aabb& bounds = entity->get_hitbox().get_bounds();
+    min_x[index] = bounds.min_x;
+    max_x[index] = bounds.max_x;
+    min_y[index] = bounds.min_y;
+    max_y[index] = bounds.max_y;
+
+    chars[index] = entity->get_char();
+    patterns[index] = entity->get_pattern();
+    sync_flags(index);
+}
+
+void EntityStore::write_back(size_t index)
+{
+    if (flags[index] & ENTITY_OWN_MOTION) {
+        return;
+    }
+    GameObject* entity = objects[index];
+    entity->set_position(Position(position_x[index], position_y[index]));
+    entity->set_velocity(Vector2(velocity_x[index], velocity_y[index]));
+}
+
+void EntityStore::add_contact_push(size_t index, const Vector2& push)
+{
+    push_x[index] += push.getX();
+    push_y[index] += push.getY();
+}
+
+void EntityStore::clear_contact_pushes()
+{
+    std::fill(push_x.begin(), push_x.end(), 0.0);
+    std::fill(push_y.begin(), push_y.end(), 0.0);
+}
+
+void EntityStore::save_previous_positions()
+{
+    previous_position_x = position_x;
+    previous_position_y = position_y;
+}
+
+void EntityStore::save_start_positions()
+{
+    start_position_x = position_x;
+    start_position_y = position_y;
+}
+
+void EntityStore::sync_flags(size_t index)
+{
+    GameObject* entity = objects[index];
+    unsigned char entity_flags = 0;
+    if (entity->is_collidable()) {
+        entity_flags |= ENTITY_COLLIDABLE;
+    }
+    if (entity->is_deletable()) {
+        entity_flags |= ENTITY_DELETABLE;
+    }
+    if (entity->is_player()) {
+        entity_flags |= ENTITY_PLAYER;
+    }
+    if (entity->is_enemy()) {
+        entity_flags |= ENTITY_ENEMY;
+    }
+    if (entity->has_own_motion()) {
+        entity_flags |= ENTITY_OWN_MOTION;
+    }
+    flags[index] = entity_flags;
+}
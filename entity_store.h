@@ -0,0 +1,104 @@
+#pragma once
+#include "util.h"
+#include "game_object.h"
+#include "aabb_batch.h"
+
+// Bits of EntityStore flags.
+enum EntityFlags : unsigned char {
+    ENTITY_COLLIDABLE = 1 << 0,
+    ENTITY_DELETABLE = 1 << 1,
+    ENTITY_PLAYER = 1 << 2,
+    ENTITY_ENEMY = 1 << 3,
+    ENTITY_OWN_MOTION = 1 << 4, // see GameObject::has_own_motion
+};
+
+// Structure-of-arrays storage of the entities of a GameSpace. Index i of every array refers to the same entity.
+// The arrays hold the motion of the entities: update() integrates it for every entity without its own
+// motion (e.g. falling objects) in a pass over contiguous arrays, without touching the GameObjects. The
+// GameObjects only keep their behaviour (collisions, damage): write_back() copies their motion to them when
+// they need it, and sync() copies them back. Entities with their own motion (the player) update themselves,
+// and are synced after.
+class EntityStore {
+    std::vector<GameObject*> objects;
+    std::vector<EntityId> ids;
+    std::vector<double> position_x, position_y;
+    std::vector<double> previous_position_x, previous_position_y; // at the end of the previous tick
+    std::vector<double> start_position_x, start_position_y; // at the start of the current step
+    std::vector<double> velocity_x, velocity_y;
+    std::vector<double> acceleration_x, acceleration_y;
+    std::vector<double> push_x, push_y; // contact push of the last tick, see add_contact_push
+    std::vector<int> size_x, size_y;
+    std::vector<double> min_x, min_y, max_x, max_y; // hitbox bounds
+    std::vector<unsigned char> flags;
+    std::vector<char> chars;
+    std::vector<Pattern> patterns;
+
+    void sync_flags(size_t index);
+
+    public:
+        // Appends entity, and returns its index.
+        size_t add(GameObject* entity);
+
+        // Removes entity at index by swapping the last entity into its place. Does not delete the GameObject.
+        void remove(size_t index);
+
+        // Removes all entities. Does not delete the GameObjects.
+        void clear();
+
+        void reserve(size_t capacity);
+
+        // Makes room to add count more entities without reallocating. Grows geometrically, so calling
+        // it before every batch of adds does not make adding quadratic.
+        void reserve_more(size_t count);
+
+        // Advances every entity by step_time: integrates the motion of the entities without their own (marking
+        // those leaving the world deletable), and updates the others, then syncs them.
+        void update(long step_time, const WorldSize& world);
+
+        // Copies the state of the GameObject at index into the arrays. Needed after anything changed it, e.g. a collision.
+        void sync(size_t index);
+
+        // Copies the position and velocity of the entity at index to its GameObject, if the arrays hold its motion.
+        // Needed before anything reads it, e.g. a collision.
+        void write_back(size_t index);
+
+        // Adds push to the velocity change of the entity at index in its next steps (see ContactCache::add_push_outs).
+        void add_contact_push(size_t index, const Vector2& push);
+
+        // Sets the contact push of every entity back to zero.
+        void clear_contact_pushes();
+
+        // Remembers the current positions as the previous ones, to interpolate between. Called at the start of every tick.
+        void save_previous_positions();
+
+        // Remembers the current positions as those the current step started from, for swept collision tests.
+        // Called at the start of every step, before the entities update.
+        void save_start_positions();
+
+        size_t size() const { return objects.size(); }
+        bool empty() const { return objects.empty(); }
+
+        GameObject* get_object(size_t index) const { return objects[index]; }
+        const std::vector<GameObject*>& get_objects() const { return objects; }
+        EntityId get_id(size_t index) const { return ids[index]; }
+        double get_position_x(size_t index) const { return position_x[index]; }
+        double get_position_y(size_t index) const { return position_y[index]; }
+        double get_previous_position_x(size_t index) const { return previous_position_x[index]; }
+        double get_previous_position_y(size_t index) const { return previous_position_y[index]; }
+        double get_start_position_x(size_t index) const { return start_position_x[index]; }
+        double get_start_position_y(size_t index) const { return start_position_y[index]; }
+        double get_velocity_x(size_t index) const { return velocity_x[index]; }
+        double get_velocity_y(size_t index) const { return velocity_y[index]; }
+        double get_acceleration_x(size_t index) const { return acceleration_x[index]; }
+        double get_acceleration_y(size_t index) const { return acceleration_y[index]; }
+        int get_size_x(size_t index) const { return size_x[index]; }
+        int get_size_y(size_t index) const { return size_y[index]; }
+        double get_min_x(size_t index) const { return min_x[index]; }
+        double get_min_y(size_t index) const { return min_y[index]; }
+        double get_max_x(size_t index) const { return max_x[index]; }
+        double get_max_y(size_t index) const { return max_y[index]; }
+        Aabb get_bounds(size_t index) const { return { min_x[index], min_y[index], max_x[index], max_y[index] }; }
+        char get_char(size_t index) const { return chars[index]; }
+        Pattern get_pattern(size_t index) const { return patterns[index]; }
+        bool has_flag(size_t index, EntityFlags flag) const { return (flags[index] & flag) != 0; }
+};
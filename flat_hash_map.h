@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open addressing (linear probing) hash map for integer keys. Slots live in one flat array and are
+// reused, so once the map has grown to its working size, inserting and erasing does not allocate.
+// Erase uses backward shift deletion, so there are no tombstones.
+template <typename Key, typename Value>
+class FlatHashMap {
+    struct Slot {
+        Key key;
+        Value value;
+        bool used;
+    };
+
+    std::vector<Slot> slots;
+    size_t num_used = 0;
+    size_t mask = 0;
+
+    static size_t hash(Key key)
+    {
+        // splitmix64 finaliser
+        uint64_t x = static_cast<uint64_t>(key);
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return static_cast<size_t>(x);
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old_slots;
+        old_slots.swap(slots);
+        size_t capacity = old_slots.empty() ? 16 : old_slots.size() * 2;
+        slots.assign(capacity, Slot { Key(), Value(), false });
+        mask = capacity - 1;
+        num_used = 0;
+        for (const Slot& slot : old_slots) {
+            if (slot.used) {
+                insert(slot.key, slot.value);
+            }
+        }
+    }
+
+    public:
+        // Returns the value of key, or nullptr if not in the map. Invalidated by insert().
+        Value* find(Key key)
+        {
+            if (slots.empty()) {
+                return nullptr;
+            }
+            for (size_t i = hash(key) & mask; slots[i].used; i = (i + 1) & mask) {
+                if (slots[i].key == key) {
+                    return &slots[i].value;
+                }
+            }
+            return nullptr;
+        }
+
+        const Value* find(Key key) const
+        {
+            return const_cast<FlatHashMap*>(this)->find(key);
+        }
+
+        // Inserts key with value if not already in the map. Returns the value of key.
+        Value& insert(Key key, const Value& value)
+        {
+            // keep load factor under 1/2
+            if ((num_used + 1) * 2 > slots.size()) {
+                grow();
+            }
+            size_t i = hash(key) & mask;
+            for (; slots[i].used; i = (i + 1) & mask) {
+                if (slots[i].key == key) {
+                    return slots[i].value;
+                }
+            }
+            slots[i] = Slot { key, value, true };
+            num_used++;
+            return slots[i].value;
+        }
+
+        // Removes key. Returns false if it was not in the map.
+        bool erase(Key key)
+        {
+            if (slots.empty()) {
+                return false;
+            }
+            size_t i = hash(key) & mask;
+            for (; slots[i].used; i = (i + 1) & mask) {
+                if (slots[i].key == key) {
+                    break;
+                }
+            }
+            if (!slots[i].used) {
+                return false;
+            }
+            // Shift back following entries that are not at their home slot
+            size_t hole = i;
+            for (size_t j = (hole + 1) & mask; slots[j].used; j = (j + 1) & mask) {
+                size_t home = hash(slots[j].key) & mask;
+                // move j into the hole if its home is not in (hole, j]
+                if (((j - home) & mask) >= ((j - hole) & mask)) {
+                    slots[hole] = slots[j];
+                    hole = j;
+                }
+            }
+            slots[hole].used = false;
+            num_used--;
+            return true;
+        }
+
+        // Removes all keys, keeping the slots.
+        void clear()
+        {
+            for (Slot& slot : slots) {
+                slot.used = false;
+            }
+            num_used = 0;
+        }
+
+        // Removes all keys and frees the slots.
+        void release()
+        {
+            std::vector<Slot>().swap(slots);
+            num_used = 0;
+            mask = 0;
+        }
+
+        size_t size() const { return num_used; }
+        size_t get_capacity() const { return slots.size(); }
+        bool empty() const { return num_used == 0; }
+
+        // Calls func(key, value) for every entry. func must not insert or erase.
+        template <typename F>
+        void for_each(F func)
+        {
+            for (Slot& slot : slots) {
+                if (slot.used) {
+                    func(slot.key, slot.value);
+                }
+            }
+        }
+};
@@ -0,0 +1,187 @@
+#include "framebuffer.h"
+#include <algorithm>
+
+// Unchanged cells between two changed ones are rewritten rather than skipped if there are fewer
+// than this many, as moving the cursor costs about as much
+constexpr int RUN_MERGE_GAP = 6;
+
+// Returns the number of decimal digits of n.
+static size_t get_num_digits(int n)
+{
+    size_t digits = 1;
+    for (; n >= 10; n /= 10) {
+        digits++;
+    }
+    return digits;
+}
+
+// Returns the size of "ESC [ y ; x H", which moves the cursor to (y, x).
+static size_t get_cursor_move_bytes(int y, int x)
+{
+    return 4 + get_num_digits(y + 1) + get_num_digits(x + 1);
+}
+
+static char to_ascii(char c)
+{
+    switch (c) {
+        case BORDER_VERTICAL:
+            return '|';
+        case BORDER_HORIZONTAL:
+            return '-';
+        case BORDER_CORNER:
+            return '+';
+        default:
+            return c;
+    }
+}
+
+// Calls on_run(y, x, length) for every run of cells where is_marked(y, x), merging runs closer than RUN_MERGE_GAP.
+template <typename Marked, typename OnRun>
+static void for_each_run(int width, int height, Marked is_marked, OnRun on_run)
+{
+    for (int y = 0; y < height; y++) {
+        int x = 0;
+        while (x < width) {
+            if (!is_marked(y, x)) {
+                x++;
+                continue;
+            }
+            int end = x + 1;
+            for (int next = x + 1; next < width && next - end < RUN_MERGE_GAP; next++) {
+                if (is_marked(y, next)) {
+                    end = next + 1;
+                }
+            }
+            on_run(y, x, end - x);
+            x = end;
+        }
+    }
+}
+
+FrameBuffer::FrameBuffer(int width, int height) : width(width), height(height), cells(width * height, ' '), previous(width * height, ' ')
+{
+}
+
+void FrameBuffer::find_changed_runs()
+{
+    runs.clear();
+    stats = FrameStats();
+    for (int i = 0; i < width * height; i++) {
+        stats.changed_cells += !previous_valid || cells[i] != previous[i];
+    }
+    for_each_run(width, height,
+        [this](int y, int x) { return !previous_valid || cells[y * width + x] != previous[y * width + x]; },
+        [this](int y, int x, int length) {
+            runs.push_back(Run { y, x, length });
+            stats.bytes += get_cursor_move_bytes(y, x) + length;
+        });
+    stats.runs = runs.size();
+}
+
+void FrameBuffer::clear()
+{
+    std::fill(cells.begin(), cells.end(), ' ');
+}
+
+void FrameBuffer::draw_box()
+{
+    for (int x = 1; x < width - 1; x++) {
+        at(0, x) = BORDER_HORIZONTAL;
+        at(height - 1, x) = BORDER_HORIZONTAL;
+    }
+    for (int y = 1; y < height - 1; y++) {
+        at(y, 0) = BORDER_VERTICAL;
+        at(y, width - 1) = BORDER_VERTICAL;
+    }
+    at(0, 0) = at(0, width - 1) = at(height - 1, 0) = at(height - 1, width - 1) = BORDER_CORNER;
+}
+
+void FrameBuffer::put_char(int y, int x, char c)
+{
+    if (y < 0 || y >= height || x < 0 || x >= width) {
+        return;
+    }
+    at(y, x) = c;
+}
+
+void FrameBuffer::put_str(int y, int x, const std::string& str)
+{
+    for (size_t i = 0; i < str.length(); i++) {
+        put_char(y, x + i, str[i]);
+    }
+}
+
+char FrameBuffer::get_char(int y, int x) const
+{
+    return cells[y * width + x];
+}
+
+void FrameBuffer::invalidate()
+{
+    previous_valid = false;
+}
+
+void FrameBuffer::present(WINDOW* window)
+{
+    find_changed_runs();
+    for (const Run& run : runs) {
+        wmove(window, run.y, run.x);
+        for (int x = run.x; x < run.x + run.length; x++) {
+            char c = at(run.y, x);
+            switch (c) {
+                case BORDER_VERTICAL:
+                    waddch(window, ACS_VLINE);
+                    break;
+                case BORDER_HORIZONTAL:
+                    waddch(window, ACS_HLINE);
+                    break;
+                case BORDER_CORNER:
+                    // corners are told apart by position, like box() does
+                    waddch(window, run.y == 0 ? (x == 0 ? ACS_ULCORNER : ACS_URCORNER) : (x == 0 ? ACS_LLCORNER : ACS_LRCORNER));
+                    break;
+                default:
+                    waddch(window, c);
+                    break;
+            }
+        }
+    }
+    previous = cells;
+    previous_valid = true;
+}
+
+void FrameBuffer::encode_diff(std::string& out)
+{
+    find_changed_runs();
+    for (const Run& run : runs) {
+        out += "\x1b[" + std::to_string(run.y + 1) + ";" + std::to_string(run.x + 1) + "H";
+        for (int x = run.x; x < run.x + run.length; x++) {
+            out += to_ascii(at(run.y, x));
+        }
+    }
+    previous = cells;
+    previous_valid = true;
+}
+
+size_t FrameBuffer::get_full_repaint_bytes() const
+{
+    size_t bytes = 4; // ESC [ 2 J
+    for_each_run(width, height,
+        [this](int y, int x) { return cells[y * width + x] != ' '; },
+        [&bytes](int y, int x, int length) { bytes += get_cursor_move_bytes(y, x) + length; });
+    return bytes;
+}
+
+const FrameStats& FrameBuffer::get_last_stats() const
+{
+    return stats;
+}
+
+int FrameBuffer::get_width() const
+{
+    return width;
+}
+
+int FrameBuffer::get_height() const
+{
+    return height;
+}
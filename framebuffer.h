@@ -0,0 +1,78 @@
+#pragma once
+#include <iostream>
+
+#ifdef _WIN32
+#include <ncurses/ncurses.h>
+#elif __APPLE__ || defined(LINUX)
+#include "ncurses.h"
+#else
+# error "Unknown compiler"
+#endif
+
+#include <string>
+#include <vector>
+#include "util.h"
+
+// Cells of the window border, drawn with the terminal's line characters.
+constexpr char BORDER_VERTICAL = '\x01';
+constexpr char BORDER_HORIZONTAL = '\x02';
+constexpr char BORDER_CORNER = '\x03';
+
+// What the last present() or encode_diff() sent.
+struct FrameStats {
+    size_t changed_cells = 0;
+    size_t runs = 0;
+    size_t bytes = 0; // as ANSI escape sequences and characters
+};
+
+// Off-screen character buffer the game is drawn into every frame. Presenting it compares it with
+// the previous frame and only writes the runs of cells that changed, so a frame where a few objects
+// moved costs a few cursor moves and characters instead of a repaint of the whole window.
+class FrameBuffer {
+    struct Run {
+        int y, x, length;
+    };
+
+    int width;
+    int height;
+    std::vector<char> cells;
+    std::vector<char> previous; // cells as last presented
+    bool previous_valid = false;
+    std::vector<Run> runs;
+    FrameStats stats;
+
+    char& at(int y, int x) { return cells[y * width + x]; }
+    // Collects the runs of cells that differ from the previous frame, and counts their ANSI size.
+    void find_changed_runs();
+
+    public:
+        FrameBuffer(int width = MAX_X, int height = MAX_Y);
+
+        // Blanks every cell.
+        void clear();
+        // Draws the window border, like box(window, 0, 0).
+        void draw_box();
+        // Writes c at (y, x). Ignored outside the buffer.
+        void put_char(int y, int x, char c);
+        // Writes str from (y, x) on one line, clipped at the right edge.
+        void put_str(int y, int x, const std::string& str);
+        char get_char(int y, int x) const;
+
+        // Forgets what was presented, so the next present() rewrites every cell. Call it when something
+        // else has drawn on the window.
+        void invalidate();
+
+        // Writes the cells that changed since the last present() to window. Does not refresh it.
+        void present(WINDOW* window);
+
+        // Appends the ANSI escape sequences that turn the previous frame into this one to out, and makes
+        // this frame the previous one. Used to measure output without a terminal.
+        void encode_diff(std::string& out);
+
+        // Returns the size in bytes of a full repaint of this frame (clear screen, then every non-blank run).
+        size_t get_full_repaint_bytes() const;
+
+        const FrameStats& get_last_stats() const;
+        int get_width() const;
+        int get_height() const;
+};
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <mutex>
 #include <cstring>
 #include <sstream>
 
@@ -18,12 +20,45 @@
 
 #include "game_space.h"
 #include "game_text.h"
+#include "triple_buffer.h"
+#include "input_log.h"
+#include "profiler.h"
+#include "trace.h"
+#include <fstream>
 
 using namespace std;
 
 constexpr int FRAME_RATE = 60;
 constexpr double FRAME_TIME = 1000000.0/FRAME_RATE; // in microseconds
+// During the game stage, the simulation thread updates the game space SIM_RATE times per second, whatever
+// the frame rate is (the game space itself simulates in ticks of PHYSICS_TICK_TIME).
+constexpr int SIM_RATE = 60;
+constexpr double SIM_TICK_TIME = 1000000.0/SIM_RATE; // in microseconds
 GameSpace* game_space = GameSpace::get_instance();
+// The game stage is drawn into frame_buffer, and only the cells that changed are written to the window
+FrameBuffer frame_buffer;
+
+// Keys read by the render (main) thread, waiting to be handled by the simulation thread
+mutex pending_keys_mutex;
+vector<int> pending_keys;
+
+// With --record=path, every game is logged to path (replacing the last one), to be replayed by ./headless --replay=path
+string record_path;
+InputRecorder recorder;
+
+// Latencies of the render thread's phases. With --profile=path, they are written to path with those of the
+// simulation at the end of every round.
+Profiler render_profiler;
+string profile_path;
+
+// With --trace=path, both threads are traced and the trace is written to path on exit
+string trace_path;
+
+// Round and spawning of the Stress difficulty, from --spawn-rate, --sizes, --max-entities, --round and --speed
+StressConfig stress_config;
+
+// Size of the world the view scrolls over, from --world, --active-radius and --coarse-radius
+WorldConfig world_config;
 
 // Gets current time in milliseconds
 long long get_current_time() {
@@ -31,9 +66,10 @@ long long get_current_time() {
     return time.count();
 }
 
-// Get current time in microsecond
+// Get current time in microsecond. Monotonic (not wall-clock time), so only meaningful as a difference:
+// a clock adjustment must not make the simulation drop or burst ticks.
 long long get_current_time_micro() {
-    chrono::microseconds time = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch());
+    chrono::microseconds time = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch());
     return time.count();
 }
 
@@ -44,56 +80,19 @@ enum class GameStage {
     End
 };
 
-void process_input(WINDOW* window, bool& paused) {
-    vector<int> keys_pressed;
+// Reads the keys pressed during the game stage, and queues them for the simulation thread.
+// Returns false if the player quit. Render thread only, as ncurses is not thread safe.
+bool read_input(WINDOW* window) {
+    lock_guard<mutex> lock(pending_keys_mutex);
     int key_pressed = wgetch(window);
     while (key_pressed != ERR) {
-        // mvwaddch(window, y_coor, x_coor, key_pressed);
-        keys_pressed.push_back(key_pressed);
-        key_pressed = wgetch(window);
-    }
-    vector<Direction> input_directions;
-    Player* player = game_space->get_player();
-    
-    // Check if the key pressed was a special key, such as an wasd key
-    for (char key : keys_pressed) {
-        // Keys allowed during only unpause
-        if (!paused) {
-            switch (key) {
-                case 'a':       // left
-                    input_directions.push_back(Direction::Left);
-                    break; 
-                case 's':       // down
-                    input_directions.push_back(Direction::Down);
-                    break; 
-                case 'd':       // right
-                    input_directions.push_back(Direction::Right);
-                    break; 
-                case 'w':       // up
-                    input_directions.push_back(Direction::Up);
-                    break; 
-                case 't':
-                    game_space->spawn_falling_obj_random();
-                    break;
-            }
-        }
-        
-        // For any case
-        switch (key) { 
-            case 'p': // pause. just for testing
-                paused = !paused;
-                break;
-            case 'x': 
-                endwin();
-                exit(0);
-                break;
-            default:
-                break;
+        if (key_pressed == 'x') {
+            return false;
         }
+        pending_keys.push_back(key_pressed);
+        key_pressed = wgetch(window);
     }
-    player->move(input_directions);
-    
-    // cout << player->get_position() << endl;
+    return true;
 }
 
 bool process_menu_input(WINDOW* window, Difficulty& difficulty) {
@@ -111,6 +110,9 @@ bool process_menu_input(WINDOW* window, Difficulty& difficulty) {
         case '3':
             difficulty = Difficulty::Hard;
             return true;
+        case '4':
+            difficulty = Difficulty::Stress;
+            return true;
         case 'x':
             endwin();
             exit(0);
@@ -146,11 +148,95 @@ bool update(const long& frame_time) {
     return game_space->update(frame_time);
 }
 
-void render(WINDOW* window) {
+// Runs the game on its own thread until it is over or stop is set: every SIM_TICK_TIME, handles the
+// queued keys, gives the game space the time since the last update (recording both if recording), and
+// publishes a snapshot of it.
+// The game space simulates that time in fixed ticks, so slow rendering never stretches a tick, and a
+// late update catches up with more ticks (up to MAX_TICKS_PER_UPDATE).
+void run_simulation(TripleBuffer<RenderSnapshot>& snapshots, const atomic<bool>& stop) {
+    bool paused = false;
+    bool game_over = false;
+    long idle_time = 0;
+    vector<int> keys;
+    chrono::steady_clock::time_point next_tick = chrono::steady_clock::now();
+    long long prev_time = get_current_time_micro();
+    Tracer::set_thread_name("simulation");
+    while (!game_over && !stop.load()) {
+        Tracer::begin("simulation update");
+        {
+            lock_guard<mutex> lock(pending_keys_mutex);
+            keys.swap(pending_keys);
+        }
+        game_space->process_input(keys, paused);
+
+        long long current_time = get_current_time_micro();
+        long frame_time = paused ? 0 : max(0LL, current_time - prev_time);
+        if (!paused) {
+            game_over = update(frame_time);
+        }
+        prev_time = current_time;
+        if (recorder.is_open()) {
+            recorder.record_tick(frame_time, keys);
+        }
+        keys.clear();
+
+        RenderSnapshot& snapshot = snapshots.get_back();
+        game_space->take_snapshot(snapshot);
+        snapshot.tick = game_space->get_update_stats().ticks;
+        snapshot.paused = paused;
+        snapshot.game_over = game_over;
+        snapshot.sim_idle_time = idle_time;
+        snapshot.time = current_time;
+        snapshots.publish();
+        Tracer::end("simulation update");
+
+        next_tick += chrono::microseconds((long)SIM_TICK_TIME);
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (next_tick > now) {
+            idle_time = chrono::duration_cast<chrono::microseconds>(next_tick - now).count();
+            this_thread::sleep_until(next_tick);
+        } else {
+            idle_time = 0;
+            next_tick = now;
+        }
+    }
+    if (recorder.is_open()) {
+        recorder.close(game_space->get_state_hash());
+    }
+}
+
+// Writes the trace to trace_path. Registered with atexit, as the game exits from several places (always
+// from the render thread, with the simulation thread stopped).
+void write_trace() {
+    if (!Tracer::write(trace_path)) {
+        cerr << "Could not write " << trace_path << endl;
+    }
+}
+
+// Writes the phase latencies of the round that just ended to profile_path. The simulation thread must be stopped.
+void write_profile(const Difficulty& difficulty) {
+    ofstream out(profile_path);
+    const UpdateStats& stats = game_space->get_update_stats();
+    out << "Difficulty: " << difficulty << ", ticks: " << stats.ticks << ", substeps: " << stats.substeps
+        << ", time: " << game_space->get_time_elapsed() / MILLION << "s" << endl << endl;
+    out << "Simulation thread" << endl;
+    game_space->get_profiler().write(out);
+    out << endl << "Render thread" << endl;
+    render_profiler.write(out);
+}
+
+void render(FrameBuffer& frame, const RenderSnapshot& snapshot) {
     // cout << "Hi!" << endl;
-    wclear(window);
-    box(window, 0, 0);
-    game_space->print(window);
+    frame.clear();
+    if (snapshot.paused) {
+        frame.put_str(MAX_Y / 2 - 1, MAX_X / 2 - paused_str.length() / 2, paused_str);
+        frame.put_str(MAX_Y / 2 + 1, MAX_X / 2 - paused_instruction_str.length() / 2, paused_instruction_str);
+        return;
+    }
+    frame.draw_box();
+    // The simulation has gone on since the snapshot, so entities are drawn further towards their current position
+    double alpha = snapshot.alpha + (get_current_time_micro() - snapshot.time) / (double)PHYSICS_TICK_TIME;
+    snapshot.draw(frame, min(alpha, 1.0));
 }
 
 void display_main_menu(WINDOW* window, const bool& test_mode) {
@@ -231,9 +317,44 @@ void handler(int sig) {
 }
 
 int main(int argc, char* argv[]) {
+    bool test_mode = false;
+    BroadphaseType broadphase_type = BroadphaseType::UniformGrid;
+    bool broadphase_set = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "test") {
+            test_mode = true;
+        } else if (arg.compare(0, 13, "--broadphase=") == 0 && parse_broadphase_type(arg.substr(13), broadphase_type)) {
+            broadphase_set = true;
+        } else if (arg.compare(0, 9, "--record=") == 0 && arg.length() > 9) {
+            record_path = arg.substr(9);
+        } else if (arg.compare(0, 10, "--profile=") == 0 && arg.length() > 10) {
+            profile_path = arg.substr(10);
+        } else if (arg.compare(0, 8, "--trace=") == 0 && arg.length() > 8) {
+            trace_path = arg.substr(8);
+        } else if (parse_stress_option(arg, stress_config) || parse_world_option(arg, world_config)) {
+            continue;
+        } else {
+            cerr << "Usage: " << argv[0] << " [test] [--broadphase=grid|quadtree|sap|hash] [--record=path] [--profile=path] [--trace=path] "
+                << STRESS_OPTIONS_USAGE << " " << WORLD_OPTIONS_USAGE << endl;
+            return 1;
+        }
+    }
+    // The grid only covers the view
+    if (world_config.is_large() && !broadphase_set) {
+        broadphase_type = BroadphaseType::SpatialHash;
+    }
+    game_space->set_broadphase(broadphase_type);
+    game_space->set_stress_config(stress_config);
+    game_space->set_world(world_config);
+    if (!trace_path.empty()) {
+        Tracer::enable();
+        Tracer::set_thread_name("render");
+        atexit(write_trace);
+    }
+
     signal(SIGSEGV, handler);
     signal(10, handler); // SIGBUS
-    srand(time(0));
     
     initscr();              // Start curses mode
     cbreak();               // Line buffering disabled
@@ -254,7 +375,6 @@ int main(int argc, char* argv[]) {
     wrefresh(play_win);
     // nodelay(play_win, TRUE);
 
-    bool test_mode = argc >= 2 && strcmp(argv[1], "test") == 0;
     bool playing = true;
     GameStage game_stage = GameStage::SelectDifficulty;
     Difficulty difficulty = Difficulty::NotSet;
@@ -296,52 +416,102 @@ int main(int argc, char* argv[]) {
                 break;
             }
             case GameStage::Game: {
+                // Everything the game depends on besides the keys and frame times, so it can be replayed
+                ReplayHeader replay_header;
+                replay_header.seed = chrono::steady_clock::now().time_since_epoch().count();
+                replay_header.difficulty = static_cast<int>(difficulty);
+                replay_header.test_mode = test_mode;
+                replay_header.broadphase_type = broadphase_type;
+                replay_header.stress = stress_config;
+                replay_header.world = world_config;
+                game_space->set_seed(replay_header.seed);
+                game_space->set_broadphase(broadphase_type);
                 game_space->reset(difficulty, test_mode);
-                bool paused = false;
+                game_space->reset_update_stats();
+                render_profiler.reset();
                 nodelay(play_win, FALSE);
                 
                 mvwaddstr(play_win, MAX_Y/2, MAX_X/2 - instruction_text.length()/2, instruction_text.c_str());
                 wgetch(play_win);
 
                 nodelay(play_win, TRUE);
-                long prev_time = get_current_time_micro();
-                bool game_over = false;
-                while (!game_over) {
-                    long current_time = get_current_time_micro();
-                    long elapsed = current_time - prev_time;
-                    prev_time = current_time;
+                werase(play_win);
+                frame_buffer.invalidate();
+                pending_keys.clear();
+                if (!record_path.empty() && !recorder.open(record_path, replay_header)) {
+                    endwin();
+                    cerr << "Could not write " << record_path << endl;
+                    exit(1);
+                }
 
-                    werase(play_win);
-                    process_input(play_win, paused);
-
-                    if (!paused) {
-                        game_over = update(elapsed);
-                        render(play_win);
-                        // display_game_stage(play_win, game_stage);
-                    } else {
-                        mvwaddstr(play_win, MAX_Y / 2 - 1, MAX_X / 2 - paused_str.length() / 2, paused_str.c_str());
-                        mvwaddstr(play_win, MAX_Y / 2 + 1, MAX_X / 2 - paused_instruction_str.length() / 2, paused_instruction_str.c_str());
+                // The game space is only touched by the simulation thread until it is joined
+                TripleBuffer<RenderSnapshot> snapshots;
+                atomic<bool> stop_simulation(false);
+                thread simulation(run_simulation, ref(snapshots), cref(stop_simulation));
+                bool quit = false;
+                while (true) {
+                    // The whole frame, including the sleep until the next one, so late frames stand out
+                    TraceScope trace("frame");
+                    long frame_start = get_current_time_micro();
+
+                    if (!read_input(play_win)) {
+                        quit = true;
+                        break;
                     }
+                    snapshots.update_front();
+                    const RenderSnapshot& snapshot = snapshots.get_front();
+                    if (snapshot.game_over) {
+                        break;
+                    }
+                    {
+                        ProfileScope scope(&render_profiler, ProfilePhase::Render);
+                        render(frame_buffer, snapshot);
+                    }
+                    // display_game_stage(play_win, game_stage);
                     
                     // string paused_str = "Paused: " + to_string(paused);
                     // mvwaddstr(play_win, 2, 0, paused_str.c_str());
 
                     
-                    long process_elapsed = get_current_time_micro() - prev_time;
+                    long process_elapsed = get_current_time_micro() - frame_start;
                     long time_until_next_frame = (long)(FRAME_TIME) - process_elapsed;
                     
                     if (test_mode) {
                         string debug_frame_time_str = "FRAME_TIME: " + to_string(FRAME_TIME) + ". TIME_TO_NEXT_FRAME: " + to_string(time_until_next_frame);
-                        mvwaddstr(play_win, 5, MAX_X - debug_frame_time_str.length() - 1, debug_frame_time_str.c_str());
+                        frame_buffer.put_str(5, MAX_X - debug_frame_time_str.length() - 1, debug_frame_time_str);
+                        const FrameStats& frame_stats = frame_buffer.get_last_stats();
+                        string debug_output_str = "Last frame: " + to_string(frame_stats.changed_cells) + " cells, " + to_string(frame_stats.bytes) + " bytes";
+                        frame_buffer.put_str(6, MAX_X - debug_output_str.length() - 1, debug_output_str);
+                        string debug_sim_str = "Sim tick: " + to_string(snapshot.tick) + ". Sim idle: " + to_string(snapshot.sim_idle_time) + "us";
+                        frame_buffer.put_str(7, MAX_X - debug_sim_str.length() - 1, debug_sim_str);
+                        // Below the simulation phases, drawn by the snapshot
+                        for (ProfilePhase phase : { ProfilePhase::Render, ProfilePhase::Present }) {
+                            string phase_str = render_profiler.format_phase(phase);
+                            frame_buffer.put_str(PROFILE_HUD_ROW + static_cast<int>(phase), MAX_X - phase_str.length() - 1, phase_str);
+                        }
                     }
                     
-                    wrefresh(play_win);
+                    {
+                        ProfileScope scope(&render_profiler, ProfilePhase::Present);
+                        frame_buffer.present(play_win);
+                        wrefresh(play_win);
+                    }
+                    Tracer::counter("frame bytes", frame_buffer.get_last_stats().bytes);
                     if (time_until_next_frame <= 0) {
                         continue;
                     }
                     
                     this_thread::sleep_for(chrono::microseconds(time_until_next_frame));
                 }
+                stop_simulation.store(true);
+                simulation.join();
+                if (!profile_path.empty()) {
+                    write_profile(difficulty);
+                }
+                if (quit) {
+                    endwin();
+                    exit(0);
+                }
                 wclear(play_win);
                 game_stage = GameStage::End;
                 break;
@@ -2,22 +2,30 @@
 #include "util.h"
 
 class GameSpace;
+class GameObjectPool;
 class GameObject;
 
+// Bounding box of a GameObject, centered on its position. It is only recomputed when it is read
+// after the position changed (see invalidate()).
 class HitBox {
     private:
         GameObject* game_object;
-        Rect rect;
+        mutable Aabb bounds;
+        mutable bool dirty = true;
     public:
         HitBox(GameObject* game_object) : game_object(game_object) {}
         GameObject* get_game_object() const;
-        Rect get_rect() const;
-        void update();
-        bool intersects(const HitBox& hitbox);
+        // Returns the bounds, recomputing them if the GameObject moved since they were last read.
+        const Aabb& get_bounds() const;
+        // Marks the bounds out of date. Called whenever the GameObject's position changes.
+        void invalidate();
+        bool intersects(const HitBox& hitbox) const;
 };
 
 class GameObject {
     protected:
+        EntityId id = 0;
+        GameObjectPool* pool = nullptr;
         int size_x, size_y, mass;
         bool deletable = false;
         char representing_char;
@@ -26,11 +34,11 @@ class GameObject {
         HitBox hitbox;
         Vector2 velocity;
         bool collidable = true;
-        std::list<GameObjectFrameInfo> colliding_entities_frame_info;
+        bool transient = false;
+        size_t store_index = 0;
 
         int get_fixed_size(int size, const Pattern& pattern);
         void update_hitbox();
-        void update_velocity_from_collisions(long frameTime);
     public:
         GameObject(Position position = Position(0,0), int size_x = 1, int size_y = 1, Pattern pattern = Pattern::Cross, Vector2 velocity = Vector2(0, 0));
         virtual ~GameObject() = default;
@@ -44,12 +52,38 @@ class GameObject {
         // Overriden by objects to show if it is an enemy.
         virtual bool is_enemy() const = 0;
 
+        // Returns the id assigned by GameSpace when the GameObject was added to it.
+        EntityId get_id() const;
+
+        // Sets the id of the GameObject. Called by GameSpace.
+        void set_id(EntityId id);
+
+        // Returns the pool the GameObject was allocated from, or nullptr if allocated with new.
+        GameObjectPool* get_pool() const;
+
+        // Sets the pool the GameObject was allocated from. Called by GameSpace::instantiate().
+        void set_pool(GameObjectPool* pool);
+
+        // Returns the index of the GameObject in the EntityStore it is in. Set by EntityStore.
+        size_t get_store_index() const;
+
+        // Sets the index of the GameObject in its EntityStore. Called by EntityStore.
+        void set_store_index(size_t index);
+
+        // Overriden by GameObjects that move themselves in update() (e.g. Player) to return true. By default, returns
+        // false: while in a GameSpace, the EntityStore integrates the motion (acceleration, velocity and position) and
+        // the position and velocity are only written back when needed (see EntityStore::write_back).
+        virtual bool has_own_motion() const;
+
         // Returns the position of the GameObject.
         Position get_position() const;
 
         // Returns the velocity of the GameObject.
         virtual Vector2 get_velocity();
 
+        // Returns the acceleration of the GameObject. By default, not accelerating.
+        virtual Vector2 get_acceleration() const;
+
         // Sets the position of the GameObject.
         void set_position(const Position& pos); 
 
@@ -60,7 +94,7 @@ class GameObject {
         Pattern get_pattern() const;
 
         // Returns the hitbox of the GameObject.
-        HitBox get_hitbox() const;
+        const HitBox& get_hitbox() const;
 
         // Returns defined size_x (length).
         int get_size_x() const;
@@ -74,32 +108,31 @@ class GameObject {
         // Returns the bool 'deletable'. If true, will be removed from 'entities' List in GameSpace.
         bool is_deletable() const;
 
+        // Sets the bool 'deletable'.
+        void set_deletable(bool deletable);
+
         // Sets the bool 'collidable'. Self explanatory. CollisionDetector & CollisionCells ignore not collidable GameObjects.
         void set_collidable(bool collidable);
 
         // Returns the bool 'collidable'.
         bool is_collidable() const;
 
+        // Sets the bool 'transient'. Transient GameObjects (e.g. spawned falling objects) are not part of the
+        // world: in a large world, GameSpace destroys them once they leave the simulated chunks.
+        void set_transient(bool transient);
+
+        // Returns the bool 'transient'.
+        bool is_transient() const;
+
         // Returns true if this hitbox intersects with another GameObject's hitbox.
         bool intersects(GameObject* entity);
 
         // Handle collision with another GameObject. Accepts GOFI, specifying collided with entity and relevant info (e.g. velocity).
         virtual void handle_collision(const GameObjectFrameInfo& gofi);
 
-        // Update currently colliding entities with this GameObject. Removes no longer colliding entities.
-        void update_existing_colliding_entities();
-
-        // Pushes back GameObjectFrameInfo to colliding_entities_frame_info vector.
-        void add_colliding_entity_info(const GameObjectFrameInfo& gofi);
-
-        // Checks if colliding_entity is colliding with this GameObject.
-        bool is_colliding_with(GameObject* colliding_entity);
-
-        // Clears the colliding_entities vector.
-        void clear_colliding_entities();
-
-        // Abstract update function to be overriden by derived classes. Called by GameSpace update(), in turn called by game_loop.cpp
-        virtual void update(long frameTime) = 0;
+        // Abstract update function to be overriden by derived classes. Called by GameSpace update(), in turn called by game_loop.cpp,
+        // for the GameObjects with their own motion, and for coarse ticks (see GameSpace::set_world).
+        virtual void update(long frameTime, const WorldSize& world) = 0;
 };
 
 
@@ -1,75 +1,394 @@
 #include "game_space.h"
+#include <cmath>
 
 GameSpace::GameSpace(Difficulty difficulty, bool test_mode) : difficulty(difficulty), player(new Player(test_mode)), entities(), game_timer(static_cast<long>(difficulty) * MILLION), test_mode(test_mode)
 {
-    entities.push_front(player);
+    collision_detector.set_profiler(&profiler);
+    add_entity(player);
 }
 
 GameSpace::~GameSpace() {
-    for (GameObject*& entity : entities) {
-        delete entity;
-        entity = nullptr;
+    delete_all_entities();
+    player = nullptr; // already deleted, inside entities
+}
+
+void GameSpace::add_entity(GameObject* entity)
+{
+    entity->set_id(next_entity_id++);
+    Position position = bound_to_space(entity->get_position(), world_size);
+    entity->set_position(position);
+    if (world.is_large() && !entity->is_player()
+        && !is_chunk_active(get_chunk_coordinate(position.getX()), get_chunk_coordinate(position.getY()))) {
+        chunks.add(entity);
+        return;
+    }
+    entities.add(entity);
+}
+
+bool GameSpace::is_chunk_active(int chunk_x, int chunk_y) const
+{
+    return std::abs(chunk_x - player_chunk_x) <= world.active_radius && std::abs(chunk_y - player_chunk_y) <= world.active_radius;
+}
+
+bool GameSpace::is_chunk_simulated(int chunk_x, int chunk_y) const
+{
+    int radius = std::max(world.active_radius, world.coarse_radius);
+    return std::abs(chunk_x - player_chunk_x) <= radius && std::abs(chunk_y - player_chunk_y) <= radius;
+}
+
+void GameSpace::store_in_chunk(GameObject* entity)
+{
+    Position position = entity->get_position();
+    // Falling objects are spawned around the view, not kept as world state
+    if (entity->is_transient() && !is_chunk_simulated(get_chunk_coordinate(position.getX()), get_chunk_coordinate(position.getY()))) {
+        destroy_entity(entity);
+        num_deleted_entities++;
+        return;
+    }
+    chunks.add(entity);
+}
+
+void GameSpace::place_view()
+{
+    Position position = player->get_position();
+    player_chunk_x = get_chunk_coordinate(position.getX());
+    player_chunk_y = get_chunk_coordinate(position.getY());
+    // Centred on the player, but never past the edges of the world
+    double origin_x = std::floor(position.getX() - MAX_X / 2), origin_y = std::floor(position.getY() - MAX_Y / 2);
+    view_origin = Position(std::max(0.0, std::min(origin_x, world.width - MAX_X)),
+        std::max(0.0, std::min(origin_y, world.height - MAX_Y)));
+}
+
+void GameSpace::update_chunks()
+{
+    if (!world.is_large() || player == nullptr) {
+        return;
+    }
+    chunk_ticks++;
+    int old_chunk_x = player_chunk_x, old_chunk_y = player_chunk_y;
+    place_view();
+    if (player_chunk_x != old_chunk_x || player_chunk_y != old_chunk_y) {
+        // The chunks the player left behind are no longer simulated, so their transient entities go
+        int radius = std::max(world.active_radius, world.coarse_radius);
+        moved_entities.clear();
+        for (int y = old_chunk_y - radius; y <= old_chunk_y + radius; y++) {
+            for (int x = old_chunk_x - radius; x <= old_chunk_x + radius; x++) {
+                if (!is_chunk_simulated(x, y)) {
+                    chunks.take_chunk(x, y, moved_entities);
+                }
+            }
+        }
+        for (GameObject* entity : moved_entities) {
+            store_in_chunk(entity);
+        }
+
+        moved_entities.clear();
+        for (int y = player_chunk_y - world.active_radius; y <= player_chunk_y + world.active_radius; y++) {
+            for (int x = player_chunk_x - world.active_radius; x <= player_chunk_x + world.active_radius; x++) {
+                chunks.take_chunk(x, y, moved_entities);
+            }
+        }
+        entities.reserve_more(moved_entities.size());
+        for (GameObject* entity : moved_entities) {
+            entities.add(entity);
+        }
+    }
+
+    // Backwards, as remove() swaps the last (already visited) entity into the removed index
+    moved_entities.clear();
+    for (size_t i = entities.size(); i-- > 0;) {
+        if (entities.has_flag(i, ENTITY_PLAYER)
+            || is_chunk_active(get_chunk_coordinate(entities.get_position_x(i)), get_chunk_coordinate(entities.get_position_y(i)))) {
+            continue;
+        }
+        // Its motion goes with it, out of the arrays
+        entities.write_back(i);
+        moved_entities.push_back(entities.get_object(i));
+        entities.remove(i);
+    }
+    if (!moved_entities.empty()) {
+        // Before any is destroyed, as contacts are found by address
+        collision_detector.forget_entities(moved_entities);
+        for (GameObject* entity : moved_entities) {
+            store_in_chunk(entity);
+        }
+    }
+
+    if (world.coarse_radius > world.active_radius && chunk_ticks % COARSE_TICK_INTERVAL == 0) {
+        tick_coarse_chunks();
+    }
+    update_stats.frozen_entity_ticks += chunks.size();
+}
+
+void GameSpace::tick_coarse_chunks()
+{
+    // Taken out first, so entities moving between chunks of the ring are not ticked twice
+    moved_entities.clear();
+    for (int y = player_chunk_y - world.coarse_radius; y <= player_chunk_y + world.coarse_radius; y++) {
+        for (int x = player_chunk_x - world.coarse_radius; x <= player_chunk_x + world.coarse_radius; x++) {
+            if (!is_chunk_active(x, y)) {
+                chunks.take_chunk(x, y, moved_entities);
+            }
+        }
     }
-    for (GameObject*& entity : entities_to_delete) {
-        delete entity;
-        entity = nullptr;
+    // Only their own motion, without collisions
+    long coarse_time = COARSE_TICK_INTERVAL * PHYSICS_TICK_TIME;
+    for (GameObject* entity : moved_entities) {
+        entity->update(coarse_time, world_size);
+        if (entity->is_deletable()) {
+            destroy_entity(entity);
+            num_deleted_entities++;
+            continue;
+        }
+        Position position = entity->get_position();
+        if (is_chunk_active(get_chunk_coordinate(position.getX()), get_chunk_coordinate(position.getY()))) {
+            entities.add(entity);
+        } else {
+            store_in_chunk(entity);
+        }
     }
-    entities.clear(); entities_to_delete.clear();
-    player = nullptr; // already deleted, inside entities vector
+    update_stats.coarse_entity_ticks += moved_entities.size();
 }
 
-long GameSpace::get_next_object_spawn_time()
+void GameSpace::destroy_entity(GameObject* entity)
 {
-    double factor = (1.1 - 0.5 * game_timer.get_time_elapsed() / game_timer.get_time_to_reach()) 
+    if (entity->get_pool() != nullptr) {
+        entity->get_pool()->destroy(entity);
+        return;
+    }
+    delete entity;
+}
+
+void GameSpace::delete_all_entities()
+{
+    for (GameObject* entity : entities.get_objects()) {
+        destroy_entity(entity);
+    }
+    entities.clear();
+    moved_entities.clear();
+    chunks.take_all(moved_entities);
+    for (GameObject* entity : moved_entities) {
+        destroy_entity(entity);
+    }
+    moved_entities.clear();
+    collision_detector.clear_contacts();
+}
+
+long GameSpace::get_next_object_spawn_time(long time_elapsed) const
+{
+    if (difficulty == Difficulty::Stress) {
+        return std::max(1L, static_cast<long>(MILLION / stress_config.spawn_rate));
+    }
+    double factor = (1.1 - 0.5 * time_elapsed / game_timer.get_time_to_reach()) 
         / static_cast<double>(difficulty) * static_cast<double>(Difficulty::Easy);
     return SPAWN_FALLING_OBJECT_COOLDOWN * factor;
 }
 
-Timer spawn_timer;
-constexpr int refresh_physics_factor = REFRESH_PHYSICS_FACTOR <= 0 ? 1 : REFRESH_PHYSICS_FACTOR;
-bool GameSpace::update(long frame_time) {
+long GameSpace::get_round_seconds() const
+{
+    if (difficulty == Difficulty::Stress) {
+        return stress_config.round_seconds;
+    }
+    return static_cast<long>(difficulty);
+}
+
+void GameSpace::spawn_scheduled()
+{
+    ProfileScope scope(&profiler, ProfilePhase::Spawn);
+    long time_elapsed = game_timer.get_time_elapsed();
+    size_t count = 0;
+    for (; next_spawn_time <= time_elapsed && next_spawn_time < game_timer.get_time_to_reach(); next_spawn_time += get_next_object_spawn_time(next_spawn_time)) {
+        count++;
+    }
+    if (count == 0) {
+        return;
+    }
+    size_t room = count;
+    if (difficulty == Difficulty::Stress) {
+        // Entities waiting in chunks count too, or those falling out of the active chunks would escape the budget
+        size_t live = entities.size() + chunks.size();
+        room = stress_config.max_entities > live ? stress_config.max_entities - live : 0;
+        if (count > room) {
+            update_stats.dropped_spawns += count - room;
+        } else {
+            room = count;
+        }
+    }
+    // Room for the whole batch at once
+    entities.reserve_more(room);
+    falling_object_pool.reserve(falling_object_pool.get_stats().live + room);
+    for (size_t i = 0; i < count; i++) {
+        if (next_spawn_params == spawn_params.size()) {
+            generate_spawn_params();
+        }
+        const SpawnParams& params = spawn_params[next_spawn_params++];
+        // Dropped spawns still take their parameters, so the spawns after them do not depend on the budget
+        if (i < room) {
+            spawn_falling_obj(params);
+        }
+    }
+}
+
+int GameSpace::get_num_substeps() const
+{
+    double max_speed = 0;
+    int min_extent = 0;
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (!entities.has_flag(i, ENTITY_COLLIDABLE)) {
+            continue;
+        }
+        double speed = std::sqrt(entities.get_velocity_x(i) * entities.get_velocity_x(i) + entities.get_velocity_y(i) * entities.get_velocity_y(i));
+        max_speed = std::max(max_speed, speed);
+        int extent = std::min(entities.get_size_x(i), entities.get_size_y(i));
+        if (extent > 0 && (min_extent == 0 || extent < min_extent)) {
+            min_extent = extent;
+        }
+    }
+    if (min_extent == 0) {
+        return 1;
+    }
+    // Enough substeps that nothing moves further than the smallest hitbox in one
+    double max_distance = max_speed * PHYSICS_TICK_TIME / MILLION;
+    int substeps = std::ceil(max_distance / min_extent);
+    return std::max(1, std::min(substeps, MAX_SUBSTEPS));
+}
+
+bool GameSpace::step(long step_time) {
     bool game_over = false;
-    frame_time /= refresh_physics_factor;
-    for (int i = 0; i < refresh_physics_factor; i++) {
-        game_timer.update(frame_time);
-        spawn_timer.update(frame_time);
-        if (game_timer.is_over()) {
+    update_stats.substeps++;
+    game_timer.update(step_time);
+    if (game_timer.is_over()) {
+        return true;
+    }
+    // Every spawn due by now, however long the step was
+    spawn_scheduled();
+    
+    std::chrono::steady_clock::time_point phase_start = std::chrono::steady_clock::now();
+    Tracer::begin(get_phase_name(ProfilePhase::EntityUpdate));
+    entities.save_start_positions();
+    entities.update(step_time, world_size);
+    Tracer::end(get_phase_name(ProfilePhase::EntityUpdate));
+    std::chrono::steady_clock::time_point collision_start = std::chrono::steady_clock::now();
+    collision_detector.update(entities);
+    update_stats.impacts += collision_detector.get_num_impacts();
+    std::chrono::steady_clock::time_point deletion_start = std::chrono::steady_clock::now();
+    Tracer::begin(get_phase_name(ProfilePhase::Deletion));
+    // Backwards, as remove() swaps the last (already visited) entity into the removed index
+    for (size_t i = entities.size(); i-- > 0;) {
+        if (!entities.has_flag(i, ENTITY_DELETABLE)) {
+            continue;
+        }
+        // If player delete (dies), game over!
+        if (entities.has_flag(i, ENTITY_PLAYER)) {
+            player = nullptr;
             game_over = true;
-            break;
         }
-        if (spawn_timer.is_over()) { // time to spawn new object
-            spawn_falling_obj_random();
-            spawn_timer.set_time_to_reach(get_next_object_spawn_time());
-            spawn_timer.reset();
+        destroy_entity(entities.get_object(i));
+        entities.remove(i);
+        num_deleted_entities++;
+    }
+    Tracer::end(get_phase_name(ProfilePhase::Deletion));
+    std::chrono::steady_clock::time_point phase_end = std::chrono::steady_clock::now();
+
+    long long entity_update_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(collision_start - phase_start).count();
+    long long deletion_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(phase_end - deletion_start).count();
+    update_stats.entity_update_ns += entity_update_ns;
+    update_stats.collision_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(deletion_start - collision_start).count();
+    update_stats.deletion_ns += deletion_ns;
+    // Broadphase and narrowphase are recorded by collision_detector
+    profiler.record(ProfilePhase::EntityUpdate, entity_update_ns);
+    profiler.record(ProfilePhase::Deletion, deletion_ns);
+    return game_over;
+}
+
+bool GameSpace::update(long frame_time) {
+    accumulated_time += frame_time;
+    // Spiral of death guard: if ticks take longer to simulate than they last, the time owed would keep
+    // growing. Past MAX_TICKS_PER_UPDATE ticks, the game slows down instead.
+    long max_accumulated_time = MAX_TICKS_PER_UPDATE * PHYSICS_TICK_TIME;
+    if (accumulated_time > max_accumulated_time) {
+        update_stats.dropped_time += accumulated_time - max_accumulated_time;
+        accumulated_time = max_accumulated_time;
+    }
+    if (accumulated_time < PHYSICS_TICK_TIME) {
+        return false;
+    }
+
+    // Chosen once per update, from the speeds at the end of the last tick
+    int substeps = get_num_substeps();
+    long substep_time = PHYSICS_TICK_TIME / substeps;
+    while (accumulated_time >= PHYSICS_TICK_TIME) {
+        TraceScope trace("tick");
+        std::chrono::steady_clock::time_point tick_start = std::chrono::steady_clock::now();
+        accumulated_time -= PHYSICS_TICK_TIME;
+        entities.save_previous_positions();
+        update_stats.ticks++;
+        // Entity ids are never reused, so the ids given out in the tick count its spawns
+        EntityId first_spawned_id = next_entity_id;
+        int tick_start_deleted_entities = num_deleted_entities;
+        for (int i = 0; i < substeps; i++) {
+            // The last substep gets the rounding remainder, so the ticks add up to PHYSICS_TICK_TIME
+            long step_time = i < substeps - 1 ? substep_time : PHYSICS_TICK_TIME - (substeps - 1) * substep_time;
+            if (step(step_time)) {
+                return true;
+            }
         }
-        
-        for (GameObject* entity : entities) {
-            entity->update(frame_time);
+        update_chunks();
+        update_stats.entity_ticks += entities.size();
+        update_stats.last_tick_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tick_start).count();
+        if (Tracer::is_enabled()) {
+            Tracer::counter("spawns", next_entity_id - first_spawned_id);
+            Tracer::counter("deletions", num_deleted_entities - tick_start_deleted_entities);
+            Tracer::counter("entities", entities.size());
         }
-        collision_detector.update(entities);
-        for (GameObject* entity : entities) {
-            if (entity == nullptr) {
-                continue;
-            }
-            if (entity->is_deletable()) {
-                entities_to_delete.push_front(entity);
-                // If player delete (dies), game over!
-                if (entity->is_player()) {
-                    player = nullptr;
-                    game_over = true;
-                }
+    }
+    return false;
+}
+
+double GameSpace::get_interpolation_alpha() const
+{
+    return accumulated_time / static_cast<double>(PHYSICS_TICK_TIME);
+}
+
+void GameSpace::process_input(const std::vector<int>& keys_pressed, bool& paused) {
+    ProfileScope scope(&profiler, ProfilePhase::Input);
+    std::vector<Direction> input_directions;
+    
+    // Check if the key pressed was a special key, such as an wasd key
+    for (char key : keys_pressed) {
+        // Keys allowed during only unpause
+        if (!paused) {
+            switch (key) {
+                case 'a':       // left
+                    input_directions.push_back(Direction::Left);
+                    break; 
+                case 's':       // down
+                    input_directions.push_back(Direction::Down);
+                    break; 
+                case 'd':       // right
+                    input_directions.push_back(Direction::Right);
+                    break; 
+                case 'w':       // up
+                    input_directions.push_back(Direction::Up);
+                    break; 
+                case 't':
+                    spawn_falling_obj_random();
+                    break;
             }
         }
-        for (GameObject*& deletable_entity : entities_to_delete) {
-            entities.remove(deletable_entity);
-            delete deletable_entity;
-            deletable_entity = nullptr;
-            num_deleted_entities++;
+        
+        // For any case
+        switch (key) { 
+            case 'p': // pause. just for testing
+                paused = !paused;
+                break;
+            default:
+                break;
         }
-        entities_to_delete.clear();
     }
-    
-    return game_over;
+    if (player != nullptr) {
+        player->move(input_directions);
+    }
 }
 
 Player* GameSpace::get_player() {
@@ -98,86 +417,155 @@ GameResults GameSpace::get_game_results() const
     };
 }
 
+int GameSpace::get_num_of_entities() const
+{
+    return entities.size() + chunks.size();
+}
+
+const UpdateStats& GameSpace::get_update_stats() const
+{
+    return update_stats;
+}
+
+void GameSpace::reset_update_stats()
+{
+    update_stats = UpdateStats();
+    profiler.reset();
+}
+
+const Profiler& GameSpace::get_profiler() const
+{
+    return profiler;
+}
+
+void GameSpace::generate_spawn_params()
+{
+    for (SpawnParams& params : spawn_params) {
+        params.pos_x = rng.next_below(100);
+        if (difficulty == Difficulty::Stress) {
+            int num_sizes = stress_config.max_size - stress_config.min_size + 1;
+            params.size_x = stress_config.min_size + rng.next_below(num_sizes);
+            params.size_y = stress_config.min_size + rng.next_below(num_sizes);
+        } else {
+            params.size_x = rng.next_below((int)(6 + 1.5 * (int)difficulty / (int)Difficulty::Easy)) + 1;
+            params.size_y = rng.next_below((int)(4 + 1.5 * (int)difficulty / (int)Difficulty::Easy)) + 1;
+        }
+        params.acceleration_y = 0; // 9.81 * ((rng.next_double() - 0.5) * static_cast<double>(difficulty) / static_cast<double>(Difficulty::Easy));
+        double acceleration_x = rng.next_below(10) / 10.0;
+        params.acceleration_x = rng.next_below(2) == 1 ? -acceleration_x : acceleration_x;
+        double spread = rng.next_double() - 0.5;
+        if (difficulty == Difficulty::Stress) {
+            params.velocity_y = 4 * (spread * stress_config.speed_percent / 100.0);
+        } else {
+            params.velocity_y = 4 * (spread * static_cast<double>(difficulty) / static_cast<double>(Difficulty::Easy));
+        }
+    }
+    next_spawn_params = 0;
+}
+
 void GameSpace::spawn_falling_obj_random()
 {
-    int posX = rand() % 100;
-    int size_x = rand() % (int)(6 + 1.5 * (int)difficulty / (int)Difficulty::Easy) + 1;
-    int size_y = rand() % (int)(4 + 1.5 * (int)difficulty / (int)Difficulty::Easy) + 1;
-    double accelerationY = 0; // 9.81 * ((rand() / (double(RAND_MAX)) - 0.5) * static_cast<double>(difficulty) / static_cast<double>(Difficulty::Easy));
-    double accelerationX = rand() % 2 == 1 ? -rand() % 10 / 10.0 : rand() % 10 / 10.0;
-    double velocityY = 4 * ((rand() / (double(RAND_MAX)) - 0.5) * static_cast<double>(difficulty) / static_cast<double>(Difficulty::Easy));
+    if (next_spawn_params == spawn_params.size()) {
+        generate_spawn_params();
+    }
+    spawn_falling_obj(spawn_params[next_spawn_params++]);
+}
+
+void GameSpace::spawn_falling_obj(const SpawnParams& params)
+{
     // AcceleratingObject* obj = new AcceleratingObject(this, Position(posX, 0), size_x, size_y, true, Vector2(accelerationX, accelerationY), Vector2(0, velocityY));
     // entities.push_back(obj);
 
-    instantiate<AcceleratingObject>(Position(posX, 0), size_x, size_y, true, Vector2(accelerationX, accelerationY), Vector2(0, velocityY));
+    // At the top of the view, wherever it is in the world
+    AcceleratingObject* obj = instantiate<AcceleratingObject>(Position(view_origin.getX() + params.pos_x, view_origin.getY()), params.size_x, params.size_y, true,
+        Vector2(params.acceleration_x, params.acceleration_y), Vector2(0, params.velocity_y));
+    obj->set_transient(true);
 }
 
-AcceleratingObject* GameSpace::test_spawn_falling_obj(Position position)
+void GameSpace::set_seed(uint64_t seed, uint64_t stream)
 {
-    AcceleratingObject* fallingObject = new AcceleratingObject(position, 3, 3);
-    entities.push_back(fallingObject);
+    rng.set_seed(seed, stream);
+    next_spawn_params = spawn_params.size();
+}
+
+AcceleratingObject* GameSpace::test_spawn_falling_obj(Position position, Vector2 velocity)
+{
+    AcceleratingObject* fallingObject = new AcceleratingObject(position, 3, 3, false, Vector2(0, 0), velocity);
+    add_entity(fallingObject);
     return fallingObject;
 }
 
 void GameSpace::set_difficulty(Difficulty difficulty)
 {
     this->difficulty = difficulty;
-    game_timer.set_time_to_reach(static_cast<long>(difficulty) * MILLION);
+    game_timer.set_time_to_reach(get_round_seconds() * MILLION);
+    // Generated for the old difficulty
+    next_spawn_params = spawn_params.size();
+}
+
+void GameSpace::set_stress_config(const StressConfig& config)
+{
+    stress_config = config;
+    // Generated for the old sizes
+    next_spawn_params = spawn_params.size();
+}
+
+const StressConfig& GameSpace::get_stress_config() const
+{
+    return stress_config;
+}
+
+void GameSpace::set_world(const WorldConfig& config)
+{
+    world = config;
+    world_size = WorldSize(config.width, config.height);
+    collision_detector.set_world_size(world_size);
+}
+
+const WorldConfig& GameSpace::get_world() const
+{
+    return world;
 }
 
-void GameSpace::print(WINDOW* window)
+const WorldSize& GameSpace::get_world_size() const
 {
-    for (GameObject* entity : entities) {
-        if (entity == nullptr) continue;
-        Position pos = entity->get_position();
-        if (entity->is_player()) {
+    return world_size;
+}
+
+size_t GameSpace::get_num_of_frozen_entities() const
+{
+    return chunks.size();
+}
+
+size_t GameSpace::get_num_of_chunks() const
+{
+    return chunks.get_num_of_chunks();
+}
+
+void GameSpace::take_snapshot(RenderSnapshot& snapshot)
+{
+    ProfileScope scope(&profiler, ProfilePhase::Snapshot);
+    snapshot.clear();
+    snapshot.alpha = get_interpolation_alpha();
+    // In view coordinates. In a large world, the active chunks reach well past the view, so entities
+    // out of it are not copied.
+    double origin_x = view_origin.getX(), origin_y = view_origin.getY();
+    for (size_t index = 0; index < entities.size(); index++) {
+        double pos_x = entities.get_position_x(index) - origin_x, pos_y = entities.get_position_y(index) - origin_y;
+        int size_x = entities.get_size_x(index), size_y = entities.get_size_y(index);
+        if (world.is_large() && (pos_x + size_x < 0 || pos_x - size_x > MAX_X || pos_y + size_y < 0 || pos_y - size_y > MAX_Y)) {
+            continue;
+        }
+        snapshot.add_entity(SnapshotEntity { entities.get_previous_position_x(index) - origin_x, entities.get_previous_position_y(index) - origin_y,
+            pos_x, pos_y, size_x, size_y, entities.get_char(index), entities.get_pattern(index) });
+        if (entities.has_flag(index, ENTITY_PLAYER) && get_player() != nullptr) {
             std::string player_str = std::to_string(get_player()->get_health());
             if (test_mode) {
                 player_str += ", " + get_player()->get_velocity().to_string() + ", ";
                 // player_str += (get_player()->is_collidable() ? "collidable" : "not collidable");
                 player_str += (get_player()->is_immune() ? "immune" : "not immune");
             }
-            mvwaddstr(window, pos.getY() + entity->get_size_y() + 1, pos.getX() + entity->get_size_x() + 1, player_str.c_str());
-        }
-        // mvwaddstr(window, pos.getY() + entity->get_size_y() + 1, pos.getX() + entity->get_size_x() + 1
-        //     , entity->is_player() ? std::to_string(dynamic_cast<Player*>(entity)->get_health()).c_str() : pos.to_string().c_str());
-        int x = pos.getX(), y = pos.getY();
-        int size_x = entity->get_size_x(), size_y = entity->get_size_y();
-        char entity_char = entity->get_char();
-
-        Pattern entity_pattern = entity->get_pattern();
-        switch (entity_pattern) {
-            case Pattern::Cross:
-                for (int i = 0; i < size_x; i++) {              
-                    if (is_in_bounds(x + i - 1, y)) {
-                        mvwaddch(window, y, x + i, entity_char);
-                    }
-                    if (is_in_bounds(x - i - 1, y)) {
-                        mvwaddch(window, y, x - i, entity_char);
-                    }
-                }
-                for (int i = 0; i < size_y; i++) {
-                    if (is_in_bounds(x, y + i - 1)) {
-                        mvwaddch(window, y + i, x, entity_char);
-                    }
-                    if (is_in_bounds(x, y - i - 1)) {
-                        mvwaddch(window, y - i, x, entity_char);
-                    }
-                }
-                break;
-            case Pattern::Square: {
-                int topX = x - size_x / 2 + 1;
-                int topY = y - size_y / 2 + 1;
-                for (int tempY = topY; tempY < topY + size_y; tempY++) {
-                    for (int tempX = topX; tempX < topX + size_x; tempX++) {
-                        mvwaddch(window, tempY, tempX, entity_char);
-                    }
-                }
-                break;
-            }
-            default:
-                mvwaddch(window, y, x, entity_char);
-                break;
+            snapshot.add_label(pos_y + size_y + 1, pos_x + size_x + 1, player_str);
         }
     }
 
@@ -185,37 +573,86 @@ void GameSpace::print(WINDOW* window)
     if (test_mode) {
         time_remaining_str = "Entities: " + std::to_string(entities.size()) + ". Time remaining: " + std::to_string((game_timer.get_time_remaining()) / MILLION) + "s";
 
-        collision_detector.print(window);
+        collision_detector.print(snapshot);
+
+        std::string counters_str = "Live: " + std::to_string(entities.size());
+        if (difficulty == Difficulty::Stress) {
+            counters_str += "/" + std::to_string(stress_config.max_entities) + " (" + std::to_string(update_stats.dropped_spawns) + " dropped)";
+        }
+        counters_str += ". Contacts: " + std::to_string(collision_detector.get_contacts().size())
+            + ". Tick: " + std::to_string(update_stats.last_tick_ns / 1000) + "us";
+        snapshot.add_label(COUNTERS_HUD_ROW, MAX_X - counters_str.length() - 1, counters_str);
+        if (world.is_large()) {
+            std::string chunks_str = "Frozen: " + std::to_string(chunks.size()) + " in " + std::to_string(chunks.get_num_of_chunks())
+                + " chunks. View: " + std::to_string((int)origin_x) + ", " + std::to_string((int)origin_y);
+            snapshot.add_label(CHUNKS_HUD_ROW, MAX_X - chunks_str.length() - 1, chunks_str);
+        }
 
         std::string deleted_entities_str = "Deleted entities: " + std::to_string(num_deleted_entities);
-        mvwaddstr(window, MAX_Y - 1, MAX_X - deleted_entities_str.length() - 1, deleted_entities_str.c_str());
+        snapshot.add_label(MAX_Y - 1, MAX_X - deleted_entities_str.length() - 1, deleted_entities_str);
+
+        // Latency of the simulation phases this round, under the frame timings of the game loop
+        for (int phase = 0; phase <= static_cast<int>(ProfilePhase::Snapshot); phase++) {
+            std::string phase_str = profiler.format_phase(static_cast<ProfilePhase>(phase));
+            snapshot.add_label(PROFILE_HUD_ROW + phase, MAX_X - phase_str.length() - 1, phase_str);
+        }
     } else {
         // everything not in test mode
         time_remaining_str = "Time remaining: " + std::to_string((game_timer.get_time_remaining()) / MILLION) + "s";
     }
-    mvwaddstr(window, 3, MAX_X - time_remaining_str.length() - 1, time_remaining_str.c_str());
-
-    
-
+    snapshot.add_label(3, MAX_X - time_remaining_str.length() - 1, time_remaining_str);
 }
 
 void GameSpace::reset(Difficulty difficulty, bool test_mode)
 {
-    for (GameObject*& entity : entities) {
-        delete entity;
-        entity = nullptr;
-    }
-    for (GameObject*& entity : entities_to_delete) {
-        delete entity;
-        entity = nullptr;
-    }
-    entities.clear(); entities_to_delete.clear();
+    delete_all_entities();
 
+    next_entity_id = 1;
     set_difficulty(difficulty);
     this->test_mode = test_mode;
     player = instantiate<Player>(test_mode);
+    place_view();
+    chunk_ticks = 0;
     collision_detector.update(entities);
     game_timer.reset();
+    next_spawn_time = FIRST_SPAWN_TIME;
+    accumulated_time = 0;
+}
+
+void GameSpace::set_broadphase(BroadphaseType broadphase_type)
+{
+    collision_detector.set_broadphase(broadphase_type);
+}
+
+void GameSpace::set_num_threads(size_t num_threads, size_t min_parallel_pairs)
+{
+    collision_detector.set_num_threads(num_threads, min_parallel_pairs);
+}
+
+uint64_t GameSpace::get_state_hash() const
+{
+    // FNV-1a over the raw bits
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    auto add_entity = [&add](EntityId id, double position_x, double position_y, double velocity_x, double velocity_y) {
+        double values[4] = { position_x, position_y, velocity_x, velocity_y };
+        add(&id, sizeof(id));
+        add(values, sizeof(values));
+    };
+    for (size_t i = 0; i < entities.size(); i++) {
+        add_entity(entities.get_id(i), entities.get_position_x(i), entities.get_position_y(i), entities.get_velocity_x(i), entities.get_velocity_y(i));
+    }
+    chunks.for_each_entity([&add_entity](GameObject* entity) {
+        Position position = entity->get_position();
+        Vector2 velocity = entity->get_velocity();
+        add_entity(entity->get_id(), position.getX(), position.getY(), velocity.getX(), velocity.getY());
+    });
+    return hash;
 }
 
 GameSpace *GameSpace::get_instance()
@@ -224,143 +661,310 @@ GameSpace *GameSpace::get_instance()
     return &gamespace;
 }
 
-CollisionCell::CollisionCell(int x, int y): x(x), y(y) {
-    // entities.reserve(8);
+CollisionDetection::CollisionDetection(BroadphaseType broadphase_type, const WorldSize& world)
+    : broadphase(Broadphase::create(broadphase_type, world)), world(world), narrowphase_batches(1)
+{
 }
 
-void CollisionCell::setX(int x) {
-    this->x = x;
+void CollisionDetection::forget_entities(const std::vector<GameObject*>& removed_entities)
+{
+    contacts.remove_contacts_of(removed_entities);
 }
-void CollisionCell::setY(int y) {
-    this->y = y;
+
+void CollisionDetection::set_profiler(Profiler* profiler)
+{
+    this->profiler = profiler;
 }
-int CollisionCell::getX() const {
-    return x;
+
+void CollisionDetection::set_broadphase(BroadphaseType broadphase_type)
+{
+    broadphase = Broadphase::create(broadphase_type, world);
 }
-int CollisionCell::getY() const {
-    return y;
+
+void CollisionDetection::set_world_size(const WorldSize& world)
+{
+    this->world = world;
+    broadphase = Broadphase::create(broadphase->get_type(), world);
 }
 
-void CollisionCell::clear_entities()
+BroadphaseType CollisionDetection::get_broadphase_type() const
 {
-    // for (GameObject* entity : entities) {
-    //     entity->clear_colliding_entities();
-    // }
-    entities.clear();
+    return broadphase->get_type();
 }
 
-void CollisionCell::add_entity(GameObject *entity)
+const std::vector<CandidatePair>& CollisionDetection::get_pairs() const
 {
+    return pairs;
+}
 
-    // Now using set
-    if (!entity) {
-        return;
-    }
-    // if (std::find(entities.begin(), entities.end(), entity) != entities.end()) { // if found, don't push_back
-    //     return;
-    // }
-    entities.insert(entity);
-    // entities.push_back(entity);
+size_t CollisionDetection::get_num_candidate_pairs() const
+{
+    return num_candidate_pairs;
 }
 
-void CollisionCell::check_collision()
+void CollisionDetection::find_pairs(const EntityStore& entities)
 {
-    if (entities.size() == 0) {
-        return;
+    ProfileScope scope(profiler, ProfilePhase::Broadphase);
+    broadphase->update(entities);
+    pairs.clear();
+    broadphase->find_pairs(pairs);
+    num_candidate_pairs = pairs.size();
+    make_pairs_unique(entities);
+}
+
+void CollisionDetection::make_pairs_unique(const EntityStore& entities)
+{
+    // A pair can be found more than once (e.g. entities sharing several grid cells). Sorting by the
+    // pair key removes duplicates, and gives an order that does not depend on the broadphase, so
+    // collisions are handled the same way whichever broadphase found them.
+    for (CandidatePair& pair : pairs) {
+        EntityId id_a = entities.get_id(pair.a), id_b = entities.get_id(pair.b);
+        if (id_a > id_b) {
+            std::swap(pair.a, pair.b);
+        }
+        pair.key = get_pair_key(id_a, id_b);
     }
+    std::sort(pairs.begin(), pairs.end(), [](const CandidatePair& p1, const CandidatePair& p2) { return p1.key < p2.key; });
+    pairs.erase(std::unique(pairs.begin(), pairs.end(), [](const CandidatePair& p1, const CandidatePair& p2) { return p1.key == p2.key; }), pairs.end());
+}
 
-    std::vector<GameObjectFrameInfo> entities_info_in_frame;
+void CollisionDetection::update(EntityStore& entities)
+{
+    find_pairs(entities);
+    check_pair_collisions(entities);
+}
+
+void CollisionDetection::set_num_threads(size_t num_threads, size_t min_parallel_pairs)
+{
+    num_threads = std::max<size_t>(num_threads, 1);
+    worker_pool.reset(num_threads > 1 ? new WorkerPool(num_threads) : nullptr);
+    intersecting_buffers.resize(num_threads);
+    narrowphase_batches.resize(num_threads);
+    this->min_parallel_pairs = min_parallel_pairs;
+}
 
-    for (GameObject* entity : entities) {
-        entity->update_existing_colliding_entities();
-        if (!entity->is_collidable()) {
+size_t CollisionDetection::get_num_threads() const
+{
+    return worker_pool ? worker_pool->get_num_threads() : 1;
+}
+
+void CollisionDetection::test_pairs(const EntityStore& entities, size_t begin, size_t end, NarrowphaseBatch& batch, std::vector<unsigned int>& intersecting) const
+{
+    // Pairs are sorted by key, so the pairs of an entity with the entities of higher id are next to
+    // each other. Each such run is tested as one box against a batch of boxes, unless it is too short
+    // for packing the batch to pay off.
+    size_t run_begin = begin;
+    while (run_begin < end) {
+        unsigned int a = pairs[run_begin].a;
+        size_t run_end = run_begin + 1;
+        while (run_end < end && pairs[run_end].a == a) {
+            run_end++;
+        }
+        Aabb box = entities.get_bounds(a);
+
+        if (run_end - run_begin < MIN_BATCH_PAIRS) {
+            for (size_t i = run_begin; i < run_end; i++) {
+                if (aabbs_overlap(box, entities.get_bounds(pairs[i].b))) {
+                    intersecting.push_back(i);
+                }
+            }
+            run_begin = run_end;
             continue;
         }
-        entities_info_in_frame.push_back(GameObjectFrameInfo(entity, entity->get_position(), entity->get_velocity()));
+
+        batch.min_x.clear();
+        batch.min_y.clear();
+        batch.max_x.clear();
+        batch.max_y.clear();
+        for (size_t i = run_begin; i < run_end; i++) {
+            unsigned int b = pairs[i].b;
+            batch.min_x.push_back(entities.get_min_x(b));
+            batch.min_y.push_back(entities.get_min_y(b));
+            batch.max_x.push_back(entities.get_max_x(b));
+            batch.max_y.push_back(entities.get_max_y(b));
+        }
+        AabbBatch others = { batch.min_x.data(), batch.min_y.data(), batch.max_x.data(), batch.max_y.data(), run_end - run_begin };
+        batch.hits.resize(get_aabb_mask_words(others.size));
+        find_aabb_overlaps(box, others, batch.hits.data());
+        for (size_t i = run_begin; i < run_end; i++) {
+            if (is_aabb_hit(batch.hits.data(), i - run_begin)) {
+                intersecting.push_back(i);
+            }
+        }
+        run_begin = run_end;
     }
+}
 
-    if (entities.size() == 1) {
+void CollisionDetection::find_intersecting_pairs(const EntityStore& entities)
+{
+    intersecting_pairs.clear();
+    if (!worker_pool || pairs.size() < min_parallel_pairs) {
+        test_pairs(entities, 0, pairs.size(), narrowphase_batches[0], intersecting_pairs);
         return;
     }
 
-    for (GameObjectFrameInfo entity_info : entities_info_in_frame) {
-        GameObject*& entity = entity_info.entity;
-        if (entity->is_deletable() || !entity->is_collidable()) {
+    // Only reads hitbox bounds, so the chunks can be tested concurrently
+    size_t num_threads = worker_pool->get_num_threads();
+    std::function<void(size_t)> job = [&](size_t worker) {
+        std::vector<unsigned int>& intersecting = intersecting_buffers[worker];
+        intersecting.clear();
+        test_pairs(entities, pairs.size() * worker / num_threads, pairs.size() * (worker + 1) / num_threads, narrowphase_batches[worker], intersecting);
+    };
+    worker_pool->run(job);
+    for (const std::vector<unsigned int>& intersecting : intersecting_buffers) {
+        intersecting_pairs.insert(intersecting_pairs.end(), intersecting.begin(), intersecting.end());
+    }
+}
+
+void CollisionDetection::check_pair_collisions(EntityStore& entities)
+{
+    ProfileScope scope(profiler, ProfilePhase::Narrowphase);
+    contacts.begin_tick();
+    contacts.end_separated_contacts(entities);
+
+    // Snapshot of every entity before any collision is handled, indexed like entities
+    frame_infos.clear();
+    for (size_t i = 0; i < entities.size(); i++) {
+        frame_infos.push_back(GameObjectFrameInfo(entities.get_object(i), Position(entities.get_position_x(i), entities.get_position_y(i)),
+            Vector2(entities.get_velocity_x(i), entities.get_velocity_y(i))));
+    }
+
+    find_intersecting_pairs(entities);
+
+    // Impacts happened during the step, before the overlaps found at its end
+    find_impacts(entities);
+    resolve_impacts(entities);
+
+    // Each pair is resolved exactly once, in pair key order, both sides getting the other's snapshot.
+    // Pairs already in contact are not resolved again, they are pushed apart instead.
+    for (unsigned int pair_index : intersecting_pairs) {
+        const CandidatePair& pair = pairs[pair_index];
+        if (entities.has_flag(pair.a, ENTITY_DELETABLE) || !entities.has_flag(pair.a, ENTITY_COLLIDABLE)
+            || entities.has_flag(pair.b, ENTITY_DELETABLE) || !entities.has_flag(pair.b, ENTITY_COLLIDABLE)) {
             continue;
         }
-        for (GameObjectFrameInfo other_entity_info : entities_info_in_frame) {
-            GameObject*& other_entity = other_entity_info.entity;
-            if (entity == other_entity || other_entity->is_deletable() || !entity->is_collidable()) {
-                continue;
-            }
-            if (entity->is_colliding_with(other_entity) || other_entity->is_colliding_with(entity)) {
-                continue;
-            }
-            if (entity->intersects(other_entity)) {
-                entity->handle_collision(other_entity_info);
-                other_entity->handle_collision(entity_info);
-            }
+        if (contacts.contains(pair.key)) {
+            continue;
         }
+        handle_collision(entities, pair.a, frame_infos[pair.a], pair.b, frame_infos[pair.b]);
+        contacts.begin_contact(pair.key, entities.get_object(pair.a), entities.get_object(pair.b));
     }
 
-    for (GameObject* entity : entities) {
-        entity->update_existing_colliding_entities();
-    }
+    contacts.end_separated_contacts(entities);
+    entities.clear_contact_pushes();
+    contacts.add_push_outs(entities);
 }
 
-int CollisionCell::get_num_of_entities() const
+void CollisionDetection::handle_collision(EntityStore& entities, size_t a, const GameObjectFrameInfo& info_a, size_t b, const GameObjectFrameInfo& info_b)
 {
-    return entities.size();
+    // Few entities collide in a tick, so only theirs are written back and synced
+    entities.write_back(a);
+    entities.write_back(b);
+    entities.get_object(a)->handle_collision(info_b);
+    entities.get_object(b)->handle_collision(info_a);
+    entities.sync(a);
+    entities.sync(b);
 }
 
-CollisionDetection::CollisionDetection()
+void CollisionDetection::find_impacts(const EntityStore& entities)
 {
-    for (size_t i = 0; i < COLLISION_GRID_Y; i++) { // i = y = rows
-        for (size_t j = 0; j < COLLISION_GRID_X; j++) { // j = x = cols
-            cells[i][j].setX(j);
-            cells[i][j].setY(i);
+    impacts.clear();
+    for (size_t mover = 0; mover < entities.size(); mover++) {
+        // Entities that just left the space are deletable, but may have hit something on their way out
+        if (!entities.has_flag(mover, ENTITY_COLLIDABLE) || entities.has_flag(mover, ENTITY_PLAYER)) {
+            continue;
+        }
+        double dx = entities.get_position_x(mover) - entities.get_start_position_x(mover);
+        double dy = entities.get_position_y(mover) - entities.get_start_position_y(mover);
+        // Slower entities overlap whatever they pass through at the end of some step
+        if (std::abs(dx) <= entities.get_size_x(mover) && std::abs(dy) <= entities.get_size_y(mover)) {
+            continue;
+        }
+        Aabb end = entities.get_bounds(mover);
+        Aabb start = { end.min_x - dx, end.min_y - dy, end.max_x - dx, end.max_y - dy };
+        Aabb swept = { std::min(start.min_x, end.min_x), std::min(start.min_y, end.min_y), std::max(start.max_x, end.max_x), std::max(start.max_y, end.max_y) };
+
+        for (size_t other = 0; other < entities.size(); other++) {
+            if (other == mover || !entities.has_flag(other, ENTITY_COLLIDABLE) || entities.has_flag(other, ENTITY_DELETABLE)) {
+                continue;
+            }
+            Aabb other_end = entities.get_bounds(other);
+            double other_dx = entities.get_position_x(other) - entities.get_start_position_x(other);
+            double other_dy = entities.get_position_y(other) - entities.get_start_position_y(other);
+            Aabb other_start = { other_end.min_x - other_dx, other_end.min_y - other_dy, other_end.max_x - other_dx, other_end.max_y - other_dy };
+            Aabb other_swept = { std::min(other_start.min_x, other_end.min_x), std::min(other_start.min_y, other_end.min_y),
+                std::max(other_start.max_x, other_end.max_x), std::max(other_start.max_y, other_end.max_y) };
+            // Overlapping at the end of the step is left to the narrowphase
+            if (!aabbs_overlap(swept, other_swept) || aabbs_overlap(end, other_end)) {
+                continue;
+            }
+            uint64_t key = get_pair_key(entities.get_id(mover), entities.get_id(other));
+            if (contacts.contains(key)) {
+                continue;
+            }
+            // In the frame of other, mover moves by the difference of their displacements
+            double time = get_time_of_impact(start, dx - other_dx, dy - other_dy, other_start);
+            if (time >= 0) {
+                impacts.push_back(Impact { time, key, (unsigned int)mover, (unsigned int)other });
+            }
         }
     }
+    // Key breaks ties, so the order does not depend on entity indices
+    std::sort(impacts.begin(), impacts.end(), [](const Impact& a, const Impact& b) {
+        return a.time < b.time || (a.time == b.time && (a.key < b.key || (a.key == b.key && a.mover < b.mover)));
+    });
 }
 
-void CollisionDetection::clear_cells()
+void CollisionDetection::resolve_impacts(EntityStore& entities)
 {
-    for (size_t i = 0; i < COLLISION_GRID_Y; i++) { // i = y = rows
-        for (size_t j = 0; j < COLLISION_GRID_X; j++) { // j = x = cols
-            cells[i][j].clear_entities();
+    num_impacts = 0;
+    impacted.assign(entities.size(), 0);
+    for (const Impact& impact : impacts) {
+        // Only the first impact of an entity counts: it changes what the entity does after
+        if (impacted[impact.mover] || impacted[impact.other]) {
+            continue;
         }
+        if (!entities.has_flag(impact.mover, ENTITY_COLLIDABLE) || entities.has_flag(impact.other, ENTITY_DELETABLE)
+            || !entities.has_flag(impact.other, ENTITY_COLLIDABLE)) {
+            continue;
+        }
+        // Both sides get the other's position at the time of impact. Positions are not rewound to it.
+        Position mover_position(entities.get_start_position_x(impact.mover) + (entities.get_position_x(impact.mover) - entities.get_start_position_x(impact.mover)) * impact.time,
+            entities.get_start_position_y(impact.mover) + (entities.get_position_y(impact.mover) - entities.get_start_position_y(impact.mover)) * impact.time);
+        Position other_position(entities.get_start_position_x(impact.other) + (entities.get_position_x(impact.other) - entities.get_start_position_x(impact.other)) * impact.time,
+            entities.get_start_position_y(impact.other) + (entities.get_position_y(impact.other) - entities.get_start_position_y(impact.other)) * impact.time);
+        handle_collision(entities, impact.mover, GameObjectFrameInfo(entities.get_object(impact.mover), mover_position, frame_infos[impact.mover].velocity),
+            impact.other, GameObjectFrameInfo(entities.get_object(impact.other), other_position, frame_infos[impact.other].velocity));
+        impacted[impact.mover] = 1;
+        impacted[impact.other] = 1;
+        num_impacts++;
     }
 }
 
-void CollisionDetection::check_cell_collisions()
+size_t CollisionDetection::get_num_impacts() const
 {
-    for (size_t i = 0; i < COLLISION_GRID_Y; i++) { // i = y = rows
-        for (size_t j = 0; j < COLLISION_GRID_X; j++) { // j = x = cols
-            cells[i][j].check_collision();
-        }
-    }
+    return num_impacts;
 }
 
-void CollisionDetection::update(const std::list<GameObject *>& entities)
+const ContactCache& CollisionDetection::get_contacts() const
 {
-    clear_cells();
-    for (GameObject* entity : entities) {
-        for (Vector2& point : entity->get_hitbox().get_rect().get_edge_points()) {
-            int cell_x = point.getX() / COLLISION_DIVISION;
-            int cell_y = point.getY() / COLLISION_DIVISION;
-            cells[cell_y][cell_x].add_entity(entity);
-        }
-    }
-    check_cell_collisions();
+    return contacts;
 }
 
-void CollisionDetection::print(WINDOW *window)
+void CollisionDetection::clear_contacts()
 {
-    for (size_t i = 0; i < COLLISION_GRID_Y; i++) {
-        for (size_t j = 0; j < COLLISION_GRID_X; j++) {
-            mvwaddstr(window, i*COLLISION_DIVISION, j*COLLISION_DIVISION, std::to_string(cells[i][j].get_num_of_entities()).c_str());
-        }
-    }
+    contacts.clear();
+}
+
+void CollisionDetection::print(RenderSnapshot& snapshot)
+{
+    broadphase->print(snapshot);
+    size_t num_begun = std::count_if(contacts.get_events().begin(), contacts.get_events().end(),
+        [](const ContactEvent& event) { return event.type == ContactEventType::Begin; });
+    std::string contacts_str = "Contacts: " + std::to_string(contacts.size()) + " (" + std::to_string(contacts.get_num_persisting())
+        + " persisting, " + std::to_string(num_begun) + " begun, " + std::to_string(contacts.get_events().size() - num_begun) + " ended)"
+        + ". Swept impacts: " + std::to_string(num_impacts);
+    snapshot.add_label(2, 1, contacts_str);
 }
 
 std::ostream& operator<<(std::ostream& os, const Difficulty& difficulty) {
@@ -377,6 +981,9 @@ std::ostream& operator<<(std::ostream& os, const Difficulty& difficulty) {
         case Difficulty::Hard:
             os << "Hard";
             break;
+        case Difficulty::Stress:
+            os << "Stress";
+            break;
     }
     return os;
 }
\ No newline at end of file
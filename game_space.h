@@ -11,55 +11,143 @@
 
 #include <set>
 #include <list>
+#include <chrono>
 #include "spawn_object.h"
 #include "player.h"
 #include "timer.h"
 #include "util.h"
+#include "entity_store.h"
+#include "object_pool.h"
+#include "broadphase.h"
+#include "worker_pool.h"
+#include "aabb_batch.h"
+#include "contact_cache.h"
+#include "rng.h"
+#include "profiler.h"
+#include "stress_config.h"
+#include "chunk_map.h"
+#include <array>
 
 enum class Difficulty {
     NotSet,
     Easy = 30,
     Medium = 50,
-    Hard = 75
+    Hard = 75,
+    // Round length, spawn rate, sizes, speed and entity budget set by a StressConfig (see
+    // GameSpace::set_stress_config). Unlike the others, the value is only an id.
+    Stress = 60
 };
 
 std::ostream& operator<<(std::ostream& os, const Difficulty& difficulty);
 
-class CollisionCell {
-    int x;
-    int y;
-    std::set<GameObject*> entities;
-    // std::vector<GameObject*> entities;
+// Finds colliding entities with a Broadphase (selectable), then handles the collisions of the candidate pairs.
+class CollisionDetection {
+    private:
+        std::unique_ptr<Broadphase> broadphase;
+        WorldSize world;
+        // Buffers kept between ticks, so after warm up update() does not allocate.
+        std::vector<CandidatePair> pairs;
+        std::vector<GameObjectFrameInfo> frame_infos;
+        size_t num_candidate_pairs = 0;
+        ContactCache contacts;
 
-    public:
-        CollisionCell(int x = 0, int y = 0);
-        void setX(int x);
-        void setY(int y);
-        int getX() const;
-        int getY() const;
-        void clear_entities();
-        void add_entity(GameObject* entity);
-        void check_collision();
+        // Narrowphase threads. The intersection tests are split over the workers in contiguous
+        // chunks of pairs, each worker writing the intersecting ones to its own buffer. Concatenating
+        // the buffers in worker order gives the same (pair key) order as testing them serially, and
+        // collisions are then handled in that order on the calling thread, so the result does not
+        // depend on the number of threads.
+        std::unique_ptr<WorkerPool> worker_pool;
+        size_t min_parallel_pairs = DEFAULT_MIN_PARALLEL_PAIRS;
+        std::vector<std::vector<unsigned int>> intersecting_buffers;
+        std::vector<unsigned int> intersecting_pairs;
 
-        int get_num_of_entities() const;
-};
+        // Bounds of the second entities of a run of pairs sharing their first entity, packed for
+        // find_aabb_overlaps. One per thread.
+        struct NarrowphaseBatch {
+            std::vector<double> min_x, min_y, max_x, max_y;
+            std::vector<uint64_t> hits;
+        };
+        std::vector<NarrowphaseBatch> narrowphase_batches;
 
-constexpr size_t COLLISION_DIVISION = 25;
-constexpr size_t COLLISION_GRID_X = static_cast<size_t>(MAX_X) / COLLISION_DIVISION + (static_cast<size_t>(MAX_X) % COLLISION_DIVISION > 0 ? 2 : 1);
-constexpr size_t COLLISION_GRID_Y = static_cast<size_t>(MAX_Y) / COLLISION_DIVISION + (static_cast<size_t>(MAX_Y) % COLLISION_DIVISION > 0 ? 2 : 1);
-class CollisionDetection {
-    private:
-        std::array<std::array<CollisionCell, COLLISION_GRID_X>, COLLISION_GRID_Y> cells;
-        void clear_cells();
-        void check_cell_collisions();
+        // Continuous collision detection. An entity moving further than its own size in a step can pass
+        // through another without them ever overlapping at the end of a step, so its hitbox is swept from
+        // where the step started to where it ended, against every other entity's (also swept, as they
+        // move too). The impacts are resolved as collisions in order of time of impact, each entity
+        // taking at most one per step.
+        struct Impact {
+            double time; // fraction of the step
+            uint64_t key;
+            unsigned int mover, other; // entity indices, mover being the fast one
+        };
+        std::vector<Impact> impacts;
+        std::vector<unsigned char> impacted;
+        size_t num_impacts = 0;
+        Profiler* profiler = nullptr;
+
+        void make_pairs_unique(const EntityStore& entities);
+        void find_intersecting_pairs(const EntityStore& entities);
+        // Appends the indices of the pairs in [begin, end) whose hitboxes intersect to intersecting.
+        void test_pairs(const EntityStore& entities, size_t begin, size_t end, NarrowphaseBatch& batch, std::vector<unsigned int>& intersecting) const;
+        void check_pair_collisions(EntityStore& entities);
+        // Finds the impacts of the fast entities during the last step, sorted by time of impact.
+        void find_impacts(const EntityStore& entities);
+        void resolve_impacts(EntityStore& entities);
+        // Lets the entities at indices a and b handle their collision, each getting the other's frame info.
+        void handle_collision(EntityStore& entities, size_t a, const GameObjectFrameInfo& info_a, size_t b, const GameObjectFrameInfo& info_b);
 
     public:
-        CollisionDetection();
-        void update(const std::list<GameObject*>& entities);
-        void print(WINDOW* window);
+        // Below this many pairs, the narrowphase is not worth splitting over threads
+        static constexpr size_t DEFAULT_MIN_PARALLEL_PAIRS = 512;
+        // Runs of fewer pairs sharing their first entity are tested one pair at a time, not as a batch
+        static constexpr size_t MIN_BATCH_PAIRS = 8;
+
+        CollisionDetection(BroadphaseType broadphase_type = BroadphaseType::UniformGrid, const WorldSize& world = WorldSize());
+        // Updates the broadphase with the entities, then handles collisions of the pairs it finds.
+        void update(EntityStore& entities);
+        // Only updates the broadphase and collects its candidate pairs, without duplicates (no collision handling).
+        void find_pairs(const EntityStore& entities);
+        // Records the broadphase and narrowphase latencies into profiler (not recorded if null, by default).
+        void set_profiler(Profiler* profiler);
+        void set_broadphase(BroadphaseType broadphase_type);
+        BroadphaseType get_broadphase_type() const;
+        // Size of the world the entities live in. Recreates the broadphase for it.
+        void set_world_size(const WorldSize& world);
+        // Unique pairs of the last update, sorted by pair key.
+        const std::vector<CandidatePair>& get_pairs() const;
+        // Number of pairs the broadphase found in the last update, before removing duplicates.
+        size_t get_num_candidate_pairs() const;
+        // Entities in contact after the last update, and the contacts that began or ended in it.
+        const ContactCache& get_contacts() const;
+        // Number of collisions found by the swept test (not the narrowphase) in the last update.
+        size_t get_num_impacts() const;
+        // Forgets all contacts. Must be called when entities are deleted without being marked deletable first.
+        void clear_contacts();
+        // Forgets the contacts of removed_entities, e.g. when they are frozen in a chunk.
+        void forget_entities(const std::vector<GameObject*>& removed_entities);
+        // Number of threads (including the calling one) the narrowphase runs on. 1 by default.
+        void set_num_threads(size_t num_threads, size_t min_parallel_pairs = DEFAULT_MIN_PARALLEL_PAIRS);
+        size_t get_num_threads() const;
+        // Adds the broadphase and contact debug information to snapshot.
+        void print(RenderSnapshot& snapshot);
         
 };
 
+// Wall-clock time spent in each phase of GameSpace::update, accumulated over ticks.
+struct UpdateStats {
+    long ticks = 0;
+    long substeps = 0;     // steps simulated, at least one per tick
+    long entity_ticks = 0; // sum of live entities over all ticks
+    long long dropped_time = 0; // in microseconds, given to update() but not simulated (see MAX_TICKS_PER_UPDATE)
+    long impacts = 0;      // collisions found by the swept test
+    long dropped_spawns = 0; // scheduled spawns dropped at the entity budget of Difficulty::Stress
+    long frozen_entity_ticks = 0; // sum of entities frozen in chunks over all ticks (see GameSpace::set_world)
+    long coarse_entity_ticks = 0; // entity updates of coarse ticks
+    long long last_tick_ns = 0; // wall-clock time of the last tick
+    long long entity_update_ns = 0;
+    long long collision_ns = 0;
+    long long deletion_ns = 0;
+};
+
 struct GameResults {
     Difficulty difficulty;
     long time_elapsed;
@@ -67,42 +155,167 @@ struct GameResults {
     int lives_remaining;
 };
 
+// Random parameters of a falling object spawned by spawn_falling_obj_random.
+struct SpawnParams {
+    int pos_x;
+    int size_x, size_y;
+    double acceleration_x, acceleration_y;
+    double velocity_y;
+};
+
+// Number of SpawnParams generated at once
+constexpr size_t SPAWN_PARAMS_BATCH = 64;
+
 constexpr long SPAWN_FALLING_OBJECT_COOLDOWN = 500000;
-constexpr int REFRESH_PHYSICS_FACTOR = 1;
+// First row of the phase latencies in the test mode HUD
+constexpr int PROFILE_HUD_ROW = 9;
+// Row of the live entity, contact and tick time counters in the test mode HUD
+constexpr int COUNTERS_HUD_ROW = 4;
+// Row of the frozen entity and chunk counters in the test mode HUD, in a large world
+constexpr int CHUNKS_HUD_ROW = 8;
+// Time into the round of the first spawn, in microseconds
+constexpr long FIRST_SPAWN_TIME = 1000000;
+
+// A tick is split into substeps when entities are fast enough to move further than the smallest hitbox
+// in one, up to this many
+constexpr int MAX_SUBSTEPS = 8;
+// Most ticks simulated by one update(). Time beyond that is dropped.
+constexpr int MAX_TICKS_PER_UPDATE = 5;
+
+// update() adds the time it is given to an accumulator and simulates it in ticks of PHYSICS_TICK_TIME, so
+// physics do not depend on the frame rate. The remainder is carried over, and get_interpolation_alpha()
+// tells how far it is into the next tick, to draw entities between their previous and current positions.
 class GameSpace {
     Difficulty difficulty;
     Player* player;
-    std::list<GameObject*> entities;
-    std::list<GameObject*> entities_to_delete;
+    EntityStore entities;
+    EntityId next_entity_id = 1;
     Timer game_timer;
+    // Game time of the next spawn of the round, in microseconds. Spawning follows game time, so it does not
+    // depend on the frame rate or tick length. Spawns are taken as they fall due, not planned for the whole
+    // round, which at the spawn rates of Difficulty::Stress would be over a million.
+    long next_spawn_time = FIRST_SPAWN_TIME;
+    long accumulated_time = 0; // not yet simulated, less than PHYSICS_TICK_TIME between updates
+    // Random numbers of this space only, so spaces can run side by side (see set_seed)
+    Pcg32 rng;
+    // Ring of spawn parameters, generated a batch at a time and used from next_spawn_params on
+    std::array<SpawnParams, SPAWN_PARAMS_BATCH> spawn_params;
+    size_t next_spawn_params = SPAWN_PARAMS_BATCH;
     bool test_mode;
+    StressConfig stress_config;
+    // Pools of the GameObjects instantiated in this space (see instantiate), so spaces share no allocator
+    ObjectPool<AcceleratingObject> falling_object_pool;
+    ObjectPool<Player> player_pool;
     int num_deleted_entities = 0;
+    UpdateStats update_stats;
+    // Latencies of the simulation phases, reset with the update stats
+    Profiler profiler;
 
     CollisionDetection collision_detector;
-    long get_next_object_spawn_time();
-    
+
+    // Large worlds (see set_world). Only entities in the chunks within world.active_radius of the player's
+    // are in entities and simulated every tick; the others wait in chunks, ticked coarsely or frozen.
+    WorldConfig world;
+    // Size of world, which bounds the entities of this space
+    WorldSize world_size;
+    ChunkMap chunks;
+    int player_chunk_x = 0, player_chunk_y = 0;
+    // Top left corner of the view in the world, following the player
+    Position view_origin;
+    unsigned long chunk_ticks = 0;
+    // Scratch buffers of update_chunks()
+    std::vector<GameObject*> moved_entities;
+
+    // Time from a spawn at time_elapsed into the round to the next one. Shorter with difficulty and as the round goes on.
+    long get_next_object_spawn_time(long time_elapsed) const;
+    // Length of a round of the current difficulty, in seconds.
+    long get_round_seconds() const;
+    // Spawns every spawn due by the current game time, as one batch.
+    void spawn_scheduled();
+    // Refills spawn_params from rng, for the current difficulty.
+    void generate_spawn_params();
+    // Number of substeps for the next ticks, from the fastest entity and the smallest hitbox.
+    int get_num_substeps() const;
+    // Simulates step_time. Returns true if the game is over.
+    bool step(long step_time);
+    // Bounds entity to the world, then adds it to entities or, if its chunk is not active, to chunks.
+    void add_entity(GameObject* entity);
+    // Returns true if the chunk at (chunk_x, chunk_y) is simulated every tick.
+    bool is_chunk_active(int chunk_x, int chunk_y) const;
+    // Returns true if the chunk at (chunk_x, chunk_y) is simulated at all, every tick or coarsely.
+    bool is_chunk_simulated(int chunk_x, int chunk_y) const;
+    // Puts entity, which is out of the active chunks, in its chunk. Transient entities out of the simulated
+    // chunks are destroyed instead.
+    void store_in_chunk(GameObject* entity);
+    // Sets the player's chunk and the view origin from the player's position.
+    void place_view();
+    // After a tick in a large world: thaws the chunks the player came close to, freezes the entities that
+    // left the active chunks, and every COARSE_TICK_INTERVAL ticks, ticks the chunks around them.
+    void update_chunks();
+    void tick_coarse_chunks();
+    // Returns entity to the pool it was allocated from (or deletes it if it was not pooled).
+    void destroy_entity(GameObject* entity);
+    void delete_all_entities();
+
     public:
         GameSpace(Difficulty difficulty = Difficulty::Easy, bool test_mode = false);
         ~GameSpace();
+        // Handles the keys pressed since the last update: moving the player (wasd), spawning ('t') and pausing ('p').
+        void process_input(const std::vector<int>& keys_pressed, bool& paused);
+        // Simulates frame_time, in whole ticks. Returns true if the game is over.
         bool update(long frame_time);
+        // Fraction of a tick that update() was given but has not simulated yet, in [0, 1).
+        double get_interpolation_alpha() const;
         Player* get_player();
         Player* get_player() const;
         long get_time_elapsed() const;
         GameResults get_game_results() const;
+        // Number of entities, including those in chunks.
+        int get_num_of_entities() const;
+
+        // Phase timings of update(), used by the headless driver.
+        const UpdateStats& get_update_stats() const;
+        // Resets the update stats and the profiler.
+        void reset_update_stats();
+        // Latency histograms of the simulation phases. Only to be read from the thread updating the space.
+        const Profiler& get_profiler() const;
 
         void spawn_falling_obj_random();
-        AcceleratingObject* test_spawn_falling_obj(Position position);
+        void spawn_falling_obj(const SpawnParams& params);
+        // Seeds the random numbers of the space (spawns). The same seed and inputs give the same game.
+        // Spaces run side by side (e.g. one per thread) can share a seed and each take their own stream.
+        void set_seed(uint64_t seed, uint64_t stream = 0);
+        AcceleratingObject* test_spawn_falling_obj(Position position, Vector2 velocity = Vector2(0, 0));
         void set_difficulty(Difficulty difficulty);
-        void print(WINDOW* window);
+        // Spawning of Difficulty::Stress. Takes effect from the next reset.
+        void set_stress_config(const StressConfig& config);
+        const StressConfig& get_stress_config() const;
+        // Size of the world and radii of its simulated chunks. Must be called before reset(), which places
+        // the entities in it.
+        void set_world(const WorldConfig& config);
+        const WorldConfig& get_world() const;
+        const WorldSize& get_world_size() const;
+        // Number of entities waiting in chunks (not simulated every tick), and of the chunks holding them.
+        size_t get_num_of_frozen_entities() const;
+        size_t get_num_of_chunks() const;
+        // Copies what is drawn of the space (entities, HUD, and debug information in test mode) into snapshot.
+        void take_snapshot(RenderSnapshot& snapshot);
         void reset(Difficulty difficulty, bool test_mode);
+        void set_broadphase(BroadphaseType broadphase_type);
+        void set_num_threads(size_t num_threads, size_t min_parallel_pairs = CollisionDetection::DEFAULT_MIN_PARALLEL_PAIRS);
+
+        // Hash of the state of every entity (id, position, velocity), to compare runs. Includes the entities in chunks.
+        uint64_t get_state_hash() const;
 
         static GameSpace* get_instance();
 
+        // Creates a T from this space's pool of Ts and adds it to the space.
         template <typename T, typename... X>
-        friend T* instantiate(X... args);
-};
+        T* instantiate(X&&... args);
 
-template <typename T, typename... X>
-T* instantiate(X... args);
+        // Pool of the Ts instantiated in this space. Only AcceleratingObject and Player have one.
+        template <typename T>
+        ObjectPool<T>& get_pool();
+};
 
 #include "game_space.tpp"
\ No newline at end of file
@@ -2,10 +2,24 @@
 // #include "util.h"
 
 template <typename T, typename... X>
-inline T* instantiate(X... args)
+inline T* GameSpace::instantiate(X&&... args)
 {
     static_assert(std::is_base_of<GameObject, T>::value, "");
-    T* obj = new T(args...);
-    GameSpace::get_instance()->entities.push_front(obj);
+    ObjectPool<T>& pool = get_pool<T>();
+    T* obj = pool.create(std::forward<X>(args)...);
+    obj->set_pool(&pool);
+    add_entity(obj);
     return obj;
 }
+
+template <>
+inline ObjectPool<AcceleratingObject>& GameSpace::get_pool<AcceleratingObject>()
+{
+    return falling_object_pool;
+}
+
+template <>
+inline ObjectPool<Player>& GameSpace::get_pool<Player>()
+{
+    return player_pool;
+}
@@ -8,7 +8,7 @@ const string welcome_text_v1 = "WELCOME TO EPIC GAME (epic games don't sue me)";
 const string welcome_text_v2 = "WELCOME TO FALL BLOCKS (Fall Guys, don't be bad guy)";
 const string welcome_text = "DODGE IT: ULTIMATE DODGEOUT";
 const string made_by_text = "Made by Paragon Studios";
-const string difficulty_text = "Choose your difficulty: Easy - 1, Medium - 2, Hard - 3";
+const string difficulty_text = "Choose your difficulty: Easy - 1, Medium - 2, Hard - 3, Stress - 4";
 const string exit_text = "Press X to exit the game";
 const string ready_text = "ARE YOU READY?";
 const string proceed_option_text = "Return to menu - Q, Play - E";
@@ -0,0 +1,388 @@
+// Headless simulation driver. Runs GameSpace::update with a fixed frame_time as fast as possible,
+// without initscr(), and reports how many ticks per second the engine can do.
+//
+// Usage: ./headless [ticks] [difficulty 1-4] [frame_time_us] [seed] [--broadphase=grid|quadtree|sap|hash]
+//                   [--threads=N] [--verify-threads=N] [--verify-spaces] [--render] [--profile=path]
+//                   [--trace=path] [--spawn-rate=N] [--sizes=MIN-MAX] [--max-entities=N]
+//                   [--round=SECONDS] [--speed=PERCENT] [--world=WIDTHxHEIGHT] [--active-radius=N] [--coarse-radius=N]
+//        ./headless --replay=path [--threads=N] [--profile=path] [--trace=path]
+//
+// --render also draws every tick into a FrameBuffer, as the game does, and reports the terminal
+// output per frame of a full repaint against only the cells that changed.
+//
+// --profile=path writes the latency percentiles of every simulation phase to path at the end.
+// --trace=path writes a Chrome trace (trace event JSON) of every tick and its phases to path at the end.
+//
+// --replay=path replays a game recorded with ./game --record=path as fast as possible, and fails if it
+// does not end in the recorded state.
+//
+// Difficulty 4 is the stress mode: falling objects spawn at --spawn-rate per second (1000 by default,
+// up to 20000), with sides of --sizes (1-4 by default), until --max-entities (5000 by default) are alive.
+// Rounds last --round seconds (60 by default), and --speed sets the spread of the falling speeds in percent
+// of Easy's (200 by default).
+//
+// --world=WIDTHxHEIGHT plays in a world larger than the view, split into chunks of CHUNK_SIZE. Only the
+// chunks within --active-radius chunks of the player's (1 by default) are simulated every tick, those
+// within --coarse-radius (2 by default) every COARSE_TICK_INTERVAL ticks, and the rest are frozen. The
+// broadphase defaults to hash there, as the grid only covers the view.
+//
+// --verify-threads=N runs the same seeded session on 1 and on N narrowphase threads, and fails if
+// the final states differ.
+//
+// --verify-spaces plays two streams of the seed, one after the other, then on two other GameSpaces at
+// the same time on threads of their own, and fails if either ends in a different state.
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+
+#include "game_space.h"
+#include "input_log.h"
+#include "trace.h"
+
+using namespace std;
+
+constexpr long DEFAULT_TICKS = 100000;
+constexpr long DEFAULT_FRAME_TIME = 1000000 / 60; // in microseconds
+// Spaces played at the same time by --verify-spaces
+constexpr int NUM_VERIFY_SPACES = 2;
+
+struct HeadlessConfig {
+    long ticks = DEFAULT_TICKS;
+    Difficulty difficulty = Difficulty::Easy;
+    StressConfig stress;
+    WorldConfig world;
+    long frame_time = DEFAULT_FRAME_TIME;
+    unsigned int seed = 1;
+    BroadphaseType broadphase_type = BroadphaseType::UniformGrid;
+    long num_threads = 1;
+    long verify_threads = 0; // 0 if not verifying
+    bool verify_spaces = false;
+    bool render = false;
+    string replay_path; // empty if not replaying
+    string profile_path; // empty if not writing the profile
+    string trace_path; // empty if not tracing
+};
+
+// Output the frames of a session would have written to the terminal.
+struct RenderStats {
+    long frames = 0;
+    long long full_repaint_bytes = 0;
+    long long diff_bytes = 0;
+    long long changed_cells = 0;
+};
+
+Difficulty parse_difficulty(const string& arg) {
+    if (arg == "2") {
+        return Difficulty::Medium;
+    }
+    if (arg == "3") {
+        return Difficulty::Hard;
+    }
+    if (arg == "4") {
+        return Difficulty::Stress;
+    }
+    return Difficulty::Easy;
+}
+
+// Returns false if the arguments are not valid.
+bool parse_args(int argc, char* argv[], HeadlessConfig& config) {
+    vector<string> positional;
+    bool broadphase_set = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            positional.push_back(arg);
+        } else if (arg.compare(0, 13, "--broadphase=") == 0) {
+            if (!parse_broadphase_type(arg.substr(13), config.broadphase_type)) {
+                return false;
+            }
+            broadphase_set = true;
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            config.num_threads = atol(arg.substr(10).c_str());
+        } else if (arg.compare(0, 17, "--verify-threads=") == 0) {
+            config.verify_threads = atol(arg.substr(17).c_str());
+        } else if (arg.compare(0, 8, "--trace=") == 0) {
+            config.trace_path = arg.substr(8);
+        } else if (arg.compare(0, 10, "--profile=") == 0) {
+            config.profile_path = arg.substr(10);
+        } else if (arg.compare(0, 9, "--replay=") == 0) {
+            config.replay_path = arg.substr(9);
+        } else if (arg == "--verify-spaces") {
+            config.verify_spaces = true;
+        } else if (arg == "--render") {
+            config.render = true;
+        } else if (parse_stress_option(arg, config.stress) || parse_world_option(arg, config.world)) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    if (config.world.is_large() && !broadphase_set) {
+        config.broadphase_type = BroadphaseType::SpatialHash;
+    }
+    if (positional.size() >= 1) config.ticks = atol(positional[0].c_str());
+    if (positional.size() >= 2) config.difficulty = parse_difficulty(positional[1]);
+    if (positional.size() >= 3) config.frame_time = atol(positional[2].c_str());
+    if (positional.size() >= 4) config.seed = atol(positional[3].c_str());
+    return config.ticks > 0 && config.frame_time > 0 && config.num_threads > 0 && config.verify_threads >= 0;
+}
+
+double to_ms(long long ns) {
+    return ns / 1000000.0;
+}
+
+void print_pool_stats(const string& name, const PoolStats& stats) {
+    cout << name << " pool: high-water " << stats.high_water << ", live " << stats.live << ", capacity " << stats.capacity
+        << " in " << stats.slabs << " slab(s), " << stats.allocations << " allocations" << endl;
+}
+
+// Draws the game space into frame like the game loop does, and adds what presenting it would cost to stats.
+void render_frame(GameSpace* game_space, RenderSnapshot& snapshot, FrameBuffer& frame, string& output, RenderStats& stats) {
+    game_space->take_snapshot(snapshot);
+    frame.clear();
+    frame.draw_box();
+    snapshot.draw(frame, snapshot.alpha);
+    stats.full_repaint_bytes += frame.get_full_repaint_bytes();
+    output.clear();
+    frame.encode_diff(output);
+    stats.diff_bytes += output.size();
+    stats.changed_cells += frame.get_last_stats().changed_cells;
+    stats.frames++;
+}
+
+// Plays config.ticks ticks from stream of config.seed, rendering every tick into render_stats if it is not null.
+// Returns the number of rounds played.
+int run_session(GameSpace* game_space, const HeadlessConfig& config, size_t num_threads, size_t min_parallel_pairs,
+    RenderStats* render_stats = nullptr, uint64_t stream = 0) {
+    game_space->set_seed(config.seed, stream);
+    game_space->set_broadphase(config.broadphase_type);
+    game_space->set_stress_config(config.stress);
+    game_space->set_world(config.world);
+    game_space->set_num_threads(num_threads, min_parallel_pairs);
+    // test mode keeps the player alive, so a round only ends when the game timer runs out
+    game_space->reset(config.difficulty, true);
+    game_space->reset_update_stats();
+
+    RenderSnapshot snapshot;
+    FrameBuffer frame;
+    string output;
+    int rounds = 1;
+    for (long i = 0; i < config.ticks; i++) {
+        if (game_space->update(config.frame_time)) {
+            game_space->reset(config.difficulty, true);
+            rounds++;
+        }
+        if (render_stats != nullptr) {
+            render_frame(game_space, snapshot, frame, output, *render_stats);
+        }
+    }
+    return rounds;
+}
+
+// Returns 0 if the session ends in the same state on 1 thread and on config.verify_threads threads.
+// The parallel run splits every tick's pairs over the threads, however few there are.
+int verify_threads(GameSpace* game_space, const HeadlessConfig& config) {
+    run_session(game_space, config, 1, 0);
+    uint64_t serial_hash = game_space->get_state_hash();
+    run_session(game_space, config, config.verify_threads, 0);
+    uint64_t parallel_hash = game_space->get_state_hash();
+
+    cout << "State hash on 1 thread: " << hex << serial_hash << dec << ", on " << config.verify_threads
+        << " threads: " << hex << parallel_hash << dec << endl;
+    if (serial_hash != parallel_hash) {
+        cout << "MISMATCH" << endl;
+        return 1;
+    }
+    cout << "MATCH" << endl;
+    return 0;
+}
+
+// Returns 0 if NUM_VERIFY_SPACES streams of config.seed, played one after the other on game_space, end in
+// the same states when each is played on a space of its own, all at the same time on threads of their own.
+// They would not if the spaces shared any state.
+int verify_spaces(GameSpace* game_space, const HeadlessConfig& config) {
+    uint64_t serial_hashes[NUM_VERIFY_SPACES], parallel_hashes[NUM_VERIFY_SPACES];
+    for (int i = 0; i < NUM_VERIFY_SPACES; i++) {
+        run_session(game_space, config, config.num_threads, CollisionDetection::DEFAULT_MIN_PARALLEL_PAIRS, nullptr, i);
+        serial_hashes[i] = game_space->get_state_hash();
+    }
+    GameSpace spaces[NUM_VERIFY_SPACES];
+    vector<thread> threads;
+    for (int i = 0; i < NUM_VERIFY_SPACES; i++) {
+        threads.emplace_back([&spaces, &parallel_hashes, &config, i]() {
+            run_session(&spaces[i], config, config.num_threads, CollisionDetection::DEFAULT_MIN_PARALLEL_PAIRS, nullptr, i);
+            parallel_hashes[i] = spaces[i].get_state_hash();
+        });
+    }
+    for (thread& space_thread : threads) {
+        space_thread.join();
+    }
+
+    int result = 0;
+    for (int i = 0; i < NUM_VERIFY_SPACES; i++) {
+        cout << "State hash of stream " << i << " played alone: " << hex << serial_hashes[i] << ", alongside the others: "
+            << parallel_hashes[i] << dec << endl;
+        if (serial_hashes[i] != parallel_hashes[i]) {
+            result = 1;
+        }
+    }
+    cout << (result == 0 ? "MATCH" : "MISMATCH") << endl;
+    return result;
+}
+
+// Writes the phase latencies of the session to config.profile_path, if set.
+void write_profile(GameSpace* game_space, const HeadlessConfig& config) {
+    if (config.profile_path.empty()) {
+        return;
+    }
+    ofstream out(config.profile_path);
+    game_space->get_profiler().write(out);
+    cout << "Phase latencies written to " << config.profile_path << endl;
+}
+
+// Writes the trace of the session to config.trace_path, if set.
+void write_trace(const HeadlessConfig& config) {
+    if (config.trace_path.empty()) {
+        return;
+    }
+    if (Tracer::write(config.trace_path)) {
+        cout << "Trace written to " << config.trace_path << endl;
+    } else {
+        cerr << "Could not write " << config.trace_path << endl;
+    }
+}
+
+// Replays the game logged at config.replay_path. Returns 0 if it ends in the state it was recorded in.
+int replay(GameSpace* game_space, const HeadlessConfig& config) {
+    InputReplay replay;
+    if (!replay.open(config.replay_path)) {
+        cerr << "Could not read replay " << config.replay_path << endl;
+        return 1;
+    }
+    const ReplayHeader& header = replay.get_header();
+    Difficulty difficulty = static_cast<Difficulty>(header.difficulty);
+    game_space->set_seed(header.seed);
+    game_space->set_broadphase(header.broadphase_type);
+    game_space->set_stress_config(header.stress);
+    game_space->set_world(header.world);
+    game_space->set_num_threads(config.num_threads);
+    game_space->reset(difficulty, header.test_mode);
+    game_space->reset_update_stats();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool paused = false;
+    long frame_time = 0;
+    long long game_time = 0;
+    vector<int> keys;
+    long updates = 0;
+    while (replay.next_tick(frame_time, keys)) {
+        game_space->process_input(keys, paused);
+        if (!paused) {
+            game_space->update(frame_time);
+        }
+        game_time += frame_time;
+        updates++;
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    long long total_ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+
+    const UpdateStats& stats = game_space->get_update_stats();
+    cout << "Replay of " << config.replay_path << ": difficulty " << difficulty << ", seed " << header.seed
+        << ", broadphase " << header.broadphase_type << (header.test_mode ? ", test mode" : "") << endl;
+    cout << "Updates: " << updates << " (" << game_time / MILLION << " s of play), ticks: " << stats.ticks << " in " << to_ms(total_ns) << " ms" << endl;
+    cout << "Ticks/sec: " << stats.ticks / (total_ns / 1000000000.0) << endl;
+
+    write_profile(game_space, config);
+
+    uint64_t recorded_hash;
+    if (!replay.get_final_state_hash(recorded_hash)) {
+        cout << "State hash: " << hex << game_space->get_state_hash() << dec << " (log is truncated, nothing to compare with)" << endl;
+        return 1;
+    }
+    cout << "State hash: " << hex << game_space->get_state_hash() << ", recorded: " << recorded_hash << dec << endl;
+    if (game_space->get_state_hash() != recorded_hash) {
+        cout << "MISMATCH" << endl;
+        return 1;
+    }
+    cout << "MATCH" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    HeadlessConfig config;
+    if (!parse_args(argc, argv, config)) {
+        cerr << "Usage: " << argv[0] << " [ticks] [difficulty 1-4] [frame_time_us] [seed] [--broadphase=grid|quadtree|sap|hash]"
+            << " [--threads=N] [--verify-threads=N] [--verify-spaces] [--render] [--profile=path] [--trace=path] " << STRESS_OPTIONS_USAGE
+            << " " << WORLD_OPTIONS_USAGE << endl;
+        cerr << "       " << argv[0] << " --replay=path [--threads=N] [--profile=path] [--trace=path]" << endl;
+        return 1;
+    }
+
+    if (!config.trace_path.empty()) {
+        Tracer::enable();
+        Tracer::set_thread_name("headless");
+    }
+
+    GameSpace* game_space = GameSpace::get_instance();
+    if (config.verify_spaces) {
+        return verify_spaces(game_space, config);
+    }
+    if (!config.replay_path.empty()) {
+        int result = replay(game_space, config);
+        write_trace(config);
+        return result;
+    }
+    if (config.verify_threads > 0) {
+        return verify_threads(game_space, config);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    RenderStats render_stats;
+    int rounds = run_session(game_space, config, config.num_threads, CollisionDetection::DEFAULT_MIN_PARALLEL_PAIRS,
+        config.render ? &render_stats : nullptr);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    const UpdateStats& stats = game_space->get_update_stats();
+    long long total_ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    long long phase_ns = stats.entity_update_ns + stats.collision_ns + stats.deletion_ns;
+    double phase_total = phase_ns > 0 ? phase_ns : 1;
+
+    cout << "Difficulty: " << config.difficulty << ", frame_time: " << config.frame_time << "us, seed: " << config.seed
+        << ", broadphase: " << config.broadphase_type << ", threads: " << config.num_threads << endl;
+    if (config.difficulty == Difficulty::Stress) {
+        cout << "Stress: " << config.stress.spawn_rate << " spawns/s, sizes " << config.stress.min_size << "-" << config.stress.max_size
+            << ", speed " << config.stress.speed_percent << "%, max entities " << config.stress.max_entities << ", rounds of "
+            << config.stress.round_seconds << " s, dropped spawns: " << stats.dropped_spawns << endl;
+    }
+    if (config.world.is_large()) {
+        double ticks = stats.ticks > 0 ? stats.ticks : 1;
+        cout << "World: " << config.world.width << "x" << config.world.height << ", active radius " << config.world.active_radius
+            << ", coarse radius " << config.world.coarse_radius << ". Frozen entities: " << game_space->get_num_of_frozen_entities()
+            << " in " << game_space->get_num_of_chunks() << " chunks (" << stats.frozen_entity_ticks / ticks << " per tick on average), "
+            << stats.coarse_entity_ticks << " coarse entity updates" << endl;
+    }
+    cout << "Ticks: " << stats.ticks << " over " << rounds << " round(s) in " << to_ms(total_ns) << " ms" << endl;
+    cout << "Ticks/sec: " << stats.ticks / (total_ns / 1000000000.0) << endl;
+    cout << "Substeps/tick: " << (stats.ticks > 0 ? (double)stats.substeps / stats.ticks : 0) << ", dropped: " << to_ms(stats.dropped_time * 1000) << " ms"
+        << ", swept impacts: " << stats.impacts << endl;
+    cout << "Entities/tick: " << (stats.ticks > 0 ? (double)stats.entity_ticks / stats.ticks : 0) << endl;
+    cout << "Entity update: " << to_ms(stats.entity_update_ns) << " ms (" << 100 * stats.entity_update_ns / phase_total << "%)" << endl;
+    cout << "Collision:     " << to_ms(stats.collision_ns) << " ms (" << 100 * stats.collision_ns / phase_total << "%)" << endl;
+    cout << "Deletion:      " << to_ms(stats.deletion_ns) << " ms (" << 100 * stats.deletion_ns / phase_total << "%)" << endl;
+    cout << "State hash: " << hex << game_space->get_state_hash() << dec << endl;
+    write_profile(game_space, config);
+    write_trace(config);
+    if (render_stats.frames > 0) {
+        double frames = render_stats.frames;
+        cout << "Output/frame: full repaint " << render_stats.full_repaint_bytes / frames << " bytes, diff "
+            << render_stats.diff_bytes / frames << " bytes (" << render_stats.changed_cells / frames << " cells changed)" << endl;
+    }
+    print_pool_stats("AcceleratingObject", game_space->get_pool<AcceleratingObject>().get_stats());
+    print_pool_stats("Player", game_space->get_pool<Player>().get_stats());
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include "input_log.h"
+#include "game_space.h"
+#include <algorithm>
+#include <iterator>
+
+#if defined(__APPLE__) || defined(LINUX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define INPUT_LOG_MMAP
+#endif
+
+static const char MAGIC[4] = { 'D', 'D', 'G', 'L' };
+// Bumped whenever the same log would replay differently (e.g. spawns drawing their random numbers differently)
+constexpr unsigned char VERSION = 5;
+constexpr size_t HEADER_SIZE = 4 + 1 + 4 + 3 + 4 + 2 + 4 + 4 + 8 + 2;
+// The buffer is written to the file once it holds this many bytes
+constexpr size_t FLUSH_SIZE = 1 << 16;
+
+static void append_varint(std::string& buffer, uint64_t value)
+{
+    while (value >= 0x80) {
+        buffer += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buffer += static_cast<char>(value);
+}
+
+static void append_le(std::string& buffer, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        buffer += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+// Returns true if value is a Difficulty a game can be played on.
+static bool is_valid_difficulty(int value)
+{
+    switch (static_cast<Difficulty>(value)) {
+        case Difficulty::Easy:
+        case Difficulty::Medium:
+        case Difficulty::Hard:
+        case Difficulty::Stress:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint64_t read_le(const unsigned char* data, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+void InputRecorder::flush_buffer()
+{
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+bool InputRecorder::open(const std::string& path, const ReplayHeader& header)
+{
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    buffer.clear();
+    buffer.append(MAGIC, 4);
+    buffer += static_cast<char>(VERSION);
+    append_le(buffer, header.seed, 4);
+    buffer += static_cast<char>(header.difficulty);
+    buffer += static_cast<char>(header.test_mode);
+    buffer += static_cast<char>(header.broadphase_type);
+    append_le(buffer, header.stress.spawn_rate, 4);
+    buffer += static_cast<char>(header.stress.min_size);
+    buffer += static_cast<char>(header.stress.max_size);
+    append_le(buffer, header.stress.max_entities, 4);
+    append_le(buffer, header.stress.round_seconds, 2);
+    append_le(buffer, header.stress.speed_percent, 2);
+    append_le(buffer, header.world.width, 4);
+    append_le(buffer, header.world.height, 4);
+    buffer += static_cast<char>(header.world.active_radius);
+    buffer += static_cast<char>(header.world.coarse_radius);
+    return true;
+}
+
+bool InputRecorder::is_open() const
+{
+    return out.is_open();
+}
+
+void InputRecorder::record_tick(long frame_time, const std::vector<int>& keys)
+{
+    append_varint(buffer, keys.size() << 1 | 1);
+    append_varint(buffer, frame_time);
+    for (int key : keys) {
+        append_varint(buffer, static_cast<unsigned int>(key));
+    }
+    if (buffer.size() >= FLUSH_SIZE) {
+        flush_buffer();
+    }
+}
+
+void InputRecorder::close(uint64_t state_hash)
+{
+    append_varint(buffer, 0);
+    append_le(buffer, state_hash, 8);
+    flush_buffer();
+    out.close();
+}
+
+InputReplay::~InputReplay()
+{
+#ifdef INPUT_LOG_MMAP
+    if (data != nullptr && fallback.empty()) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+}
+
+bool InputReplay::open(const std::string& path)
+{
+#ifdef INPUT_LOG_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t)HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    size = file_stat.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const unsigned char*>(mapped);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (fallback.size() < HEADER_SIZE) {
+        return false;
+    }
+    data = fallback.data();
+    size = fallback.size();
+#endif
+    if (!std::equal(MAGIC, MAGIC + 4, reinterpret_cast<const char*>(data)) || data[4] != VERSION) {
+        return false;
+    }
+    // Not written by InputRecorder (or by one that knew more difficulties or broadphases)
+    if (!is_valid_difficulty(data[9]) || data[11] > static_cast<int>(BroadphaseType::SpatialHash)) {
+        return false;
+    }
+    header.seed = read_le(data + 5, 4);
+    header.difficulty = data[9];
+    header.test_mode = data[10] != 0;
+    header.broadphase_type = static_cast<BroadphaseType>(data[11]);
+    header.stress.spawn_rate = read_le(data + 12, 4);
+    header.stress.min_size = data[16];
+    header.stress.max_size = data[17];
+    header.stress.max_entities = read_le(data + 18, 4);
+    header.stress.round_seconds = read_le(data + 22, 2);
+    header.stress.speed_percent = read_le(data + 24, 2);
+    header.world.width = read_le(data + 26, 4);
+    header.world.height = read_le(data + 30, 4);
+    header.world.active_radius = data[34];
+    header.world.coarse_radius = data[35];
+    if (!is_valid_stress_config(header.stress) || !is_valid_world_config(header.world)) {
+        return false;
+    }
+    offset = HEADER_SIZE;
+    return true;
+}
+
+const ReplayHeader& InputReplay::get_header() const
+{
+    return header;
+}
+
+bool InputReplay::read_varint(uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; offset < size && shift < 64; shift += 7) {
+        unsigned char byte = data[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool InputReplay::next_tick(long& frame_time, std::vector<int>& keys)
+{
+    uint64_t tag;
+    if (ended || !read_varint(tag)) {
+        return false;
+    }
+    if (tag == 0) {
+        ended = offset + 8 <= size;
+        if (ended) {
+            final_state_hash = read_le(data + offset, 8);
+            offset += 8;
+        }
+        return false;
+    }
+    uint64_t value;
+    if (!read_varint(value)) {
+        return false;
+    }
+    frame_time = value;
+    keys.clear();
+    for (uint64_t i = 0; i < tag >> 1; i++) {
+        if (!read_varint(value)) {
+            return false;
+        }
+        keys.push_back(static_cast<int>(value));
+    }
+    return true;
+}
+
+bool InputReplay::get_final_state_hash(uint64_t& state_hash) const
+{
+    state_hash = final_state_hash;
+    return ended;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "broadphase.h"
+#include "stress_config.h"
+#include "chunk_map.h"
+
+// Everything a session depends on besides the keys and frame times.
+struct ReplayHeader {
+    uint32_t seed = 0; // passed to GameSpace::set_seed before the session
+    int difficulty = 0; // a Difficulty
+    bool test_mode = false;
+    BroadphaseType broadphase_type = BroadphaseType::UniformGrid;
+    StressConfig stress; // passed to GameSpace::set_stress_config
+    WorldConfig world; // passed to GameSpace::set_world
+};
+
+// Binary log of a game session, to replay it exactly (see InputReplay):
+//   "DDGL", version byte, seed (4 bytes, little endian), difficulty, test mode and broadphase bytes, stress
+//   spawn rate (4 bytes), min and max size bytes, max entities (4 bytes), round seconds and speed percent
+//   (2 bytes each), world width and height (4 bytes each), active and coarse radius bytes,
+//   then one record per simulation update: varint (number of keys << 1 | 1), varint frame_time, a varint per key,
+//   then varint 0 and the state hash of the game space at the end (8 bytes, little endian).
+// An update without keys takes 4 bytes, so a minute at 60 updates per second is about 14KB. Written
+// through a buffer, so memory use does not grow with the session.
+class InputRecorder {
+    std::ofstream out;
+    std::string buffer;
+
+    void flush_buffer();
+
+    public:
+        // Starts a new log at path, replacing any file there. Returns false if it cannot be written.
+        bool open(const std::string& path, const ReplayHeader& header);
+        bool is_open() const;
+
+        // Records the keys given to GameSpace::process_input, then the time given to GameSpace::update (0 if paused).
+        void record_tick(long frame_time, const std::vector<int>& keys);
+
+        // Ends the log with the final state hash of the game space, and closes it.
+        void close(uint64_t state_hash);
+};
+
+// Reads a log written by InputRecorder. The file is memory mapped and read front to back, so long sessions
+// are streamed in by the OS instead of loaded up front.
+class InputReplay {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    std::vector<unsigned char> fallback; // file contents where mmap is not available
+    ReplayHeader header;
+    bool ended = false;
+    uint64_t final_state_hash = 0;
+
+    bool read_varint(uint64_t& value);
+
+    public:
+        InputReplay() = default;
+        InputReplay(const InputReplay&) = delete;
+        InputReplay& operator=(const InputReplay&) = delete;
+        ~InputReplay();
+
+        // Maps the log at path and reads its header. Returns false if it cannot be read, is not a log, or its
+        // header holds values no game can be played with (e.g. an unknown difficulty or broadphase).
+        bool open(const std::string& path);
+
+        const ReplayHeader& get_header() const;
+
+        // Reads the next update into frame_time and keys. Returns false at the end of the log (or if it is truncated).
+        bool next_tick(long& frame_time, std::vector<int>& keys);
+
+        // Returns true once next_tick() reached the end record, and sets state_hash to the hash recorded there.
+        bool get_final_state_hash(uint64_t& state_hash) const;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+class GameObject;
+
+struct PoolStats {
+    size_t live = 0;        // objects currently allocated from the pool
+    size_t high_water = 0;  // most objects ever live at once
+    size_t capacity = 0;    // slots allocated in slabs
+    size_t slabs = 0;
+    size_t allocations = 0; // total create() calls
+};
+
+// Pool a GameObject was allocated from. GameSpace returns objects to it instead of deleting them.
+class GameObjectPool {
+    public:
+        virtual ~GameObjectPool() = default;
+        virtual void destroy(GameObject* object) = 0;
+        virtual const PoolStats& get_stats() const = 0;
+};
+
+// Slab allocator for one GameObject subclass. Storage is allocated in slabs of SLAB_SIZE objects,
+// which are never freed until the pool is destroyed, so once the high-water mark is reached
+// creating and destroying objects does no heap allocation. Not thread-safe: each GameSpace owns its pools,
+// and must return every object to them before they are destroyed.
+template <typename T>
+class ObjectPool : public GameObjectPool {
+    static constexpr size_t SLAB_SIZE = 64;
+
+    union Slot {
+        Slot* next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    Slot* free_list = nullptr;
+    PoolStats stats;
+
+    void add_slab()
+    {
+        Slot* slab = new Slot[SLAB_SIZE];
+        slabs.emplace_back(slab);
+        for (size_t i = 0; i < SLAB_SIZE; i++) {
+            slab[i].next = free_list;
+            free_list = &slab[i];
+        }
+        stats.capacity += SLAB_SIZE;
+        stats.slabs++;
+    }
+
+    public:
+        ObjectPool() = default;
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+
+        template <typename... X>
+        T* create(X&&... args)
+        {
+            if (free_list == nullptr) {
+                add_slab();
+            }
+            Slot* slot = free_list;
+            free_list = slot->next;
+            T* object = new (&slot->storage) T(std::forward<X>(args)...);
+
+            stats.allocations++;
+            if (++stats.live > stats.high_water) {
+                stats.high_water = stats.live;
+            }
+            return object;
+        }
+
+        virtual void destroy(GameObject* object) override
+        {
+            T* typed_object = static_cast<T*>(object);
+            typed_object->~T();
+            Slot* slot = reinterpret_cast<Slot*>(typed_object);
+            slot->next = free_list;
+            free_list = slot;
+            stats.live--;
+        }
+
+        // Makes sure at least capacity objects can be created without allocating.
+        void reserve(size_t capacity)
+        {
+            while (stats.capacity < capacity) {
+                add_slab();
+            }
+        }
+
+        virtual const PoolStats& get_stats() const override
+        {
+            return stats;
+        }
+};
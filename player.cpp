@@ -126,22 +126,27 @@ bool Player::is_enemy() const
     return false;
 }
 
+bool Player::has_own_motion() const
+{
+    return true;
+}
+
 Vector2 Player::get_velocity()
 {
     return velocity + move_velocity;
 }
 
-void Player::update(long frameTime)
+void Player::update(long frameTime, const WorldSize& world)
 {
     float time = frameTime / MILLION;
     if (velocity.get_magnitude() > 0.0001) {
-        Rect rect = get_hitbox().get_rect();
+        const Aabb& bounds = hitbox.get_bounds();
 
         // if touching borders stop moving in that direction
-        if (is_touching_space_bottom_side(rect) || is_touching_space_top_side(rect)) {
+        if (is_touching_space_bottom_side(bounds, world) || is_touching_space_top_side(bounds, world)) {
             velocity.setY(0);
         }
-        if (is_touching_space_left_side(rect) || is_touching_space_right_side(rect)) {
+        if (is_touching_space_left_side(bounds, world) || is_touching_space_right_side(bounds, world)) {
             velocity.setX(0);
         }
         // slow velocity over time
@@ -151,7 +156,7 @@ void Player::update(long frameTime)
         // slow player controlled velocity over time
         move_velocity *= (1 - 4 * time);
     }
-    position.add_vector2_to_position_bound((velocity + move_velocity) * time);
+    add_vector2_to_position_bound(position, (velocity + move_velocity) * time, world);
     update_hitbox();
 
     if (is_immune()) {
@@ -29,7 +29,8 @@ class Player : public GameObject {
         int get_health() const;
         virtual bool is_player() const override;
         virtual bool is_enemy() const override;
+        virtual bool has_own_motion() const override;
         virtual Vector2 get_velocity() override;
-        virtual void update(long frameTime) override;
+        virtual void update(long frameTime, const WorldSize& world) override;
         virtual void handle_collision(const GameObjectFrameInfo& gofi) override;
 };
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "profiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+const char* get_phase_name(ProfilePhase phase)
+{
+    switch (phase) {
+        case ProfilePhase::Input:
+            return "input";
+        case ProfilePhase::Spawn:
+            return "spawn";
+        case ProfilePhase::EntityUpdate:
+            return "entity update";
+        case ProfilePhase::Broadphase:
+            return "broadphase";
+        case ProfilePhase::Narrowphase:
+            return "narrowphase";
+        case ProfilePhase::Deletion:
+            return "deletion";
+        case ProfilePhase::Snapshot:
+            return "snapshot";
+        case ProfilePhase::Render:
+            return "render";
+        case ProfilePhase::Present:
+            return "present";
+        case ProfilePhase::Count:
+            break;
+    }
+    return "";
+}
+
+std::ostream& operator<<(std::ostream& os, const ProfilePhase& phase)
+{
+    return os << get_phase_name(phase);
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+size_t LatencyHistogram::get_bucket(uint64_t value)
+{
+    if (value < (1u << SUB_BUCKET_BITS)) {
+        return value;
+    }
+    // value >> shift keeps the SUB_BUCKET_BITS highest bits, so is in [HALF_SUB_BUCKETS, 2 * HALF_SUB_BUCKETS)
+    int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS + 1;
+    return shift * HALF_SUB_BUCKETS + (value >> shift);
+}
+
+uint64_t LatencyHistogram::get_bucket_max(size_t bucket)
+{
+    if (bucket < (1u << SUB_BUCKET_BITS)) {
+        return bucket;
+    }
+    int shift = bucket / HALF_SUB_BUCKETS - 1;
+    uint64_t top = bucket - shift * HALF_SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    counts[get_bucket(ns)]++;
+    count++;
+    if (ns > max) {
+        max = ns;
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    counts.fill(0);
+    count = 0;
+    max = 0;
+}
+
+uint64_t LatencyHistogram::get_count() const
+{
+    return count;
+}
+
+uint64_t LatencyHistogram::get_max() const
+{
+    return max;
+}
+
+uint64_t LatencyHistogram::get_percentile(double percentile) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100 * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+        seen += counts[bucket];
+        if (seen >= target) {
+            return std::min(get_bucket_max(bucket), max);
+        }
+    }
+    return max;
+}
+
+void Profiler::record(ProfilePhase phase, uint64_t ns)
+{
+    histograms[static_cast<size_t>(phase)].record(ns);
+}
+
+void Profiler::reset()
+{
+    for (LatencyHistogram& histogram : histograms) {
+        histogram.reset();
+    }
+}
+
+const LatencyHistogram& Profiler::get_histogram(ProfilePhase phase) const
+{
+    return histograms[static_cast<size_t>(phase)];
+}
+
+static double to_us(uint64_t ns)
+{
+    return ns / 1000.0;
+}
+
+std::string Profiler::format_phase(ProfilePhase phase) const
+{
+    const LatencyHistogram& histogram = get_histogram(phase);
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1) << phase << " p50 " << to_us(histogram.get_percentile(50))
+        << " p95 " << to_us(histogram.get_percentile(95)) << " p99 " << to_us(histogram.get_percentile(99))
+        << " max " << to_us(histogram.get_max()) << " us";
+    return ss.str();
+}
+
+void Profiler::write(std::ostream& os) const
+{
+    os << std::left << std::setw(14) << "phase" << std::right << std::setw(10) << "count" << std::setw(12) << "p50 us"
+        << std::setw(12) << "p95 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+    os << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < histograms.size(); i++) {
+        const LatencyHistogram& histogram = histograms[i];
+        if (histogram.get_count() == 0) {
+            continue;
+        }
+        std::ostringstream name;
+        name << static_cast<ProfilePhase>(i);
+        os << std::left << std::setw(14) << name.str() << std::right << std::setw(10) << histogram.get_count()
+            << std::setw(12) << to_us(histogram.get_percentile(50)) << std::setw(12) << to_us(histogram.get_percentile(95))
+            << std::setw(12) << to_us(histogram.get_percentile(99)) << std::setw(12) << to_us(histogram.get_max()) << std::endl;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "trace.h"
+
+// Phases of a frame that are timed. The simulation thread times the first ones, the render thread the last two.
+enum class ProfilePhase {
+    Input,
+    Spawn,
+    EntityUpdate,
+    Broadphase,
+    Narrowphase,
+    Deletion,
+    Snapshot, // GameSpace::take_snapshot
+    Render,   // drawing a snapshot into the frame buffer
+    Present,  // writing the frame buffer to the terminal (FrameBuffer::present and wrefresh)
+    Count
+};
+
+// Returns the lower case name of phase, e.g. "entity update".
+const char* get_phase_name(ProfilePhase phase);
+std::ostream& operator<<(std::ostream& os, const ProfilePhase& phase);
+
+// Histogram of durations in nanoseconds, in the style of HdrHistogram: values below 2^SUB_BUCKET_BITS get
+// a bucket each, and every power of two above is split into 2^(SUB_BUCKET_BITS - 1) buckets, so a value is
+// known to within about 3% whatever its size. Recording is a few instructions and never allocates.
+class LatencyHistogram {
+    static constexpr int SUB_BUCKET_BITS = 6;
+    static constexpr int HALF_SUB_BUCKETS = 1 << (SUB_BUCKET_BITS - 1);
+    static constexpr size_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 2) * HALF_SUB_BUCKETS;
+
+    std::array<uint32_t, NUM_BUCKETS> counts;
+    uint64_t count = 0;
+    uint64_t max = 0;
+
+    static size_t get_bucket(uint64_t value);
+    // Returns the highest value that falls in bucket.
+    static uint64_t get_bucket_max(size_t bucket);
+
+    public:
+        LatencyHistogram();
+        void record(uint64_t ns);
+        void reset();
+
+        uint64_t get_count() const;
+        uint64_t get_max() const;
+        // Returns the value percentile percent of the recorded values are at or below (within the bucket size).
+        uint64_t get_percentile(double percentile) const;
+};
+
+// A latency histogram per ProfilePhase. Each phase must only be recorded from one thread, and a Profiler
+// only read from that thread (or once it stopped).
+class Profiler {
+    std::array<LatencyHistogram, static_cast<size_t>(ProfilePhase::Count)> histograms;
+
+    public:
+        void record(ProfilePhase phase, uint64_t ns);
+        void reset();
+        const LatencyHistogram& get_histogram(ProfilePhase phase) const;
+
+        // Returns "<phase> p50 .. p95 .. p99 .. max .. us" for the phase.
+        std::string format_phase(ProfilePhase phase) const;
+        // Writes a table of count, p50, p95, p99 and max of every phase recorded.
+        void write(std::ostream& os) const;
+};
+
+// Records how long it lives into a phase of profiler (if not null), and as a slice of the trace (if tracing).
+class ProfileScope {
+    Profiler* profiler;
+    ProfilePhase phase;
+    TraceScope trace;
+    std::chrono::steady_clock::time_point start;
+
+    public:
+        ProfileScope(Profiler* profiler, ProfilePhase phase) : profiler(profiler), phase(phase), trace(get_phase_name(phase)), start(std::chrono::steady_clock::now()) {}
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+        ~ProfileScope()
+        {
+            if (profiler != nullptr) {
+                profiler->record(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+};
@@ -0,0 +1,76 @@
+#include "render_snapshot.h"
+
+void RenderSnapshot::clear()
+{
+    entities.clear();
+    num_labels = 0;
+}
+
+void RenderSnapshot::add_entity(const SnapshotEntity& entity)
+{
+    entities.push_back(entity);
+}
+
+void RenderSnapshot::add_label(int y, int x, const std::string& str)
+{
+    if (num_labels == labels.size()) {
+        labels.push_back(SnapshotLabel { y, x, str });
+    } else {
+        SnapshotLabel& label = labels[num_labels];
+        label.y = y;
+        label.x = x;
+        label.text.assign(str);
+    }
+    num_labels++;
+}
+
+size_t RenderSnapshot::get_num_of_entities() const
+{
+    return entities.size();
+}
+
+void RenderSnapshot::draw(FrameBuffer& frame, double alpha) const
+{
+    for (const SnapshotEntity& entity : entities) {
+        int x = entity.previous_x + (entity.x - entity.previous_x) * alpha;
+        int y = entity.previous_y + (entity.y - entity.previous_y) * alpha;
+        int size_x = entity.size_x, size_y = entity.size_y;
+        char entity_char = entity.representing_char;
+        switch (entity.pattern) {
+            case Pattern::Cross:
+                for (int i = 0; i < size_x; i++) {              
+                    if (is_in_view(x + i - 1, y)) {
+                        frame.put_char(y, x + i, entity_char);
+                    }
+                    if (is_in_view(x - i - 1, y)) {
+                        frame.put_char(y, x - i, entity_char);
+                    }
+                }
+                for (int i = 0; i < size_y; i++) {
+                    if (is_in_view(x, y + i - 1)) {
+                        frame.put_char(y + i, x, entity_char);
+                    }
+                    if (is_in_view(x, y - i - 1)) {
+                        frame.put_char(y - i, x, entity_char);
+                    }
+                }
+                break;
+            case Pattern::Square: {
+                int topX = x - size_x / 2 + 1;
+                int topY = y - size_y / 2 + 1;
+                for (int tempY = topY; tempY < topY + size_y; tempY++) {
+                    for (int tempX = topX; tempX < topX + size_x; tempX++) {
+                        frame.put_char(tempY, tempX, entity_char);
+                    }
+                }
+                break;
+            }
+            default:
+                frame.put_char(y, x, entity_char);
+                break;
+        }
+    }
+    for (size_t i = 0; i < num_labels; i++) {
+        frame.put_str(labels[i].y, labels[i].x, labels[i].text);
+    }
+}
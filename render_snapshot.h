@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "util.h"
+#include "framebuffer.h"
+
+// What is drawn of an entity.
+struct SnapshotEntity {
+    real previous_x, previous_y; // at the end of the tick before
+    real x, y;
+    int size_x, size_y;
+    char representing_char;
+    Pattern pattern;
+};
+
+// Text drawn over the entities: HUD values and debug information.
+struct SnapshotLabel {
+    int y, x;
+    std::string text;
+};
+
+// Everything needed to draw the game space at one tick, copied out of it by GameSpace::take_snapshot.
+// It does not point into the game space, so it can be drawn on another thread while the simulation
+// goes on. Buffers are kept when it is cleared, so refilling a snapshot does not allocate after warm up.
+class RenderSnapshot {
+    std::vector<SnapshotEntity> entities;
+    // Labels past num_labels are left over from an earlier snapshot, kept to reuse their strings
+    std::vector<SnapshotLabel> labels;
+    size_t num_labels = 0;
+
+    public:
+        unsigned long tick = 0;   // simulation ticks done when the snapshot was taken
+        bool paused = false;
+        bool game_over = false;
+        long sim_idle_time = 0;   // in microseconds, how long the simulation waited before the tick
+        double alpha = 1;         // how far the simulation was into the next tick, see GameSpace::get_interpolation_alpha
+        long long time = 0;       // in microseconds, when the snapshot was taken (set by its user)
+
+        // Removes all entities and labels.
+        void clear();
+        void add_entity(const SnapshotEntity& entity);
+        // Adds str at (y, x), drawn like FrameBuffer::put_str.
+        void add_label(int y, int x, const std::string& str);
+        size_t get_num_of_entities() const;
+
+        // Draws the entities at alpha between their previous (0) and current (1) positions, then the labels, into frame.
+        void draw(FrameBuffer& frame, double alpha) const;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+
+// PCG32 random number generator (pcg-random.org): 64 bits of state, 32 bit outputs. Each GameSpace owns
+// one, so game instances never share hidden state (unlike rand()) and can run on different threads.
+// A generator is picked by a seed and a stream: generators with the same seed but different streams give
+// independent sequences, so spaces run side by side can share one seed (see GameSpace::set_seed).
+class Pcg32 {
+    static constexpr uint64_t MULTIPLIER = 6364136223846793005ULL;
+
+    uint64_t state = 0;
+    uint64_t increment = 1; // odd, selects the stream
+
+    public:
+        Pcg32(uint64_t seed = 0, uint64_t stream = 0)
+        {
+            set_seed(seed, stream);
+        }
+
+        void set_seed(uint64_t seed, uint64_t stream = 0)
+        {
+            state = 0;
+            increment = (stream << 1) | 1;
+            next();
+            state += seed;
+            next();
+        }
+
+        uint32_t next()
+        {
+            uint64_t old_state = state;
+            state = old_state * MULTIPLIER + increment;
+            uint32_t xorshifted = ((old_state >> 18) ^ old_state) >> 27;
+            uint32_t rotation = old_state >> 59;
+            return (xorshifted >> rotation) | (xorshifted << ((-rotation) & 31));
+        }
+
+        // Returns a number in [0, bound), without the bias of next() % bound (Lemire's method). bound must not be 0.
+        uint32_t next_below(uint32_t bound)
+        {
+            uint64_t product = static_cast<uint64_t>(next()) * bound;
+            uint32_t low = static_cast<uint32_t>(product);
+            if (low < bound) {
+                uint32_t threshold = -bound % bound;
+                while (low < threshold) {
+                    product = static_cast<uint64_t>(next()) * bound;
+                    low = static_cast<uint32_t>(product);
+                }
+            }
+            return product >> 32;
+        }
+
+        // Returns a number in [0, 1).
+        double next_double()
+        {
+            return next() * (1.0 / 4294967296.0);
+        }
+};
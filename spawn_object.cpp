@@ -18,16 +18,21 @@ bool AcceleratingObject::is_enemy() const
     return true;
 }
 
-void AcceleratingObject::update(long frameTime) {
+Vector2 AcceleratingObject::get_acceleration() const
+{
+    return affected_by_gravity ? Vector2(acceleration) + GRAVITY : acceleration;
+}
+
+// In a GameSpace, EntityStore::update integrates the same motion (plus the contact push) instead. This is
+// only called out of it, for coarse ticks, which have no contacts.
+void AcceleratingObject::update(long frameTime, const WorldSize& world) {
     double time = frameTime / MILLION;
     velocity += (affected_by_gravity ? acceleration + GRAVITY : acceleration) * time;
-    
-    update_velocity_from_collisions(frameTime);
 
     position += velocity * time;
     update_hitbox();
     
-    if (is_in_bounds(hitbox.get_rect())) {
+    if (is_in_bounds(hitbox.get_bounds(), world)) {
         return;
     }
     deletable = true;
@@ -23,6 +23,7 @@ class AcceleratingObject : public SpawnObject {
     public:
         AcceleratingObject(Position position = Position(50,0), int size_x = 3, int size_y = 3, bool affected_by_gravity = false, Vector2 acceleration = Vector2(0, 0), Vector2 velocity = Vector2(0,0));
         virtual bool is_enemy() const override;
-        virtual void update(long frameTime) override;
+        virtual Vector2 get_acceleration() const override;
+        virtual void update(long frameTime, const WorldSize& world) override;
         virtual void handle_collision(const GameObjectFrameInfo& gofi) override;
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "stress_config.h"
+#include <cstdlib>
+
+const char* const STRESS_OPTIONS_USAGE = "[--spawn-rate=N] [--sizes=MIN-MAX] [--max-entities=N] [--round=SECONDS] [--speed=PERCENT]";
+
+// Parses a whole positive number. Returns false if text is not one, or it is above max.
+static bool parse_positive(const std::string& text, unsigned long max, unsigned long& value)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::strtoul(text.c_str(), nullptr, 10);
+    return value > 0 && value <= max;
+}
+
+bool parse_stress_option(const std::string& arg, StressConfig& config)
+{
+    unsigned long value;
+    if (arg.compare(0, 13, "--spawn-rate=") == 0) {
+        if (!parse_positive(arg.substr(13), StressConfig::MAX_SPAWN_RATE, value)) {
+            return false;
+        }
+        config.spawn_rate = value;
+        return true;
+    }
+    if (arg.compare(0, 15, "--max-entities=") == 0) {
+        if (!parse_positive(arg.substr(15), UINT32_MAX, value)) {
+            return false;
+        }
+        config.max_entities = value;
+        return true;
+    }
+    if (arg.compare(0, 8, "--round=") == 0) {
+        if (!parse_positive(arg.substr(8), StressConfig::MAX_ROUND_SECONDS, value)) {
+            return false;
+        }
+        config.round_seconds = value;
+        return true;
+    }
+    if (arg.compare(0, 8, "--speed=") == 0) {
+        if (!parse_positive(arg.substr(8), StressConfig::MAX_SPEED_PERCENT, value)) {
+            return false;
+        }
+        config.speed_percent = value;
+        return true;
+    }
+    if (arg.compare(0, 8, "--sizes=") == 0) {
+        std::string sizes = arg.substr(8);
+        size_t dash = sizes.find('-');
+        unsigned long min_size, max_size;
+        // Sizes are stored in a byte in replay logs
+        if (dash == std::string::npos || !parse_positive(sizes.substr(0, dash), 255, min_size)
+            || !parse_positive(sizes.substr(dash + 1), 255, max_size) || min_size > max_size) {
+            return false;
+        }
+        config.min_size = min_size;
+        config.max_size = max_size;
+        return true;
+    }
+    return false;
+}
+
+bool is_valid_stress_config(const StressConfig& config)
+{
+    return config.spawn_rate > 0 && config.spawn_rate <= StressConfig::MAX_SPAWN_RATE
+        && config.min_size > 0 && config.min_size <= config.max_size && config.max_size <= 255
+        && config.max_entities > 0
+        && config.round_seconds > 0 && config.round_seconds <= StressConfig::MAX_ROUND_SECONDS
+        && config.speed_percent > 0 && config.speed_percent <= StressConfig::MAX_SPEED_PERCENT;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Round and spawning of Difficulty::Stress, set from the command line to load the engine far beyond the
+// other difficulties. Nothing of it comes from the Difficulty value, unlike the other difficulties'.
+struct StressConfig {
+    static constexpr uint32_t MAX_SPAWN_RATE = 20000;
+    static constexpr uint32_t MAX_ROUND_SECONDS = 3600;
+    static constexpr uint32_t MAX_SPEED_PERCENT = 1000;
+
+    uint32_t spawn_rate = 1000; // falling objects per second, up to MAX_SPAWN_RATE
+    int min_size = 1, max_size = 4; // of either side of a falling object
+    uint32_t max_entities = 5000; // live, including the player. Spawns due with this many alive are dropped.
+    uint32_t round_seconds = 60; // length of a round
+    uint32_t speed_percent = 200; // spread of the falling speeds, in percent of Difficulty::Easy's
+};
+
+// Parses "--spawn-rate=N", "--sizes=MIN-MAX", "--max-entities=N", "--round=SECONDS" or "--speed=PERCENT"
+// into config. Returns false if arg is not one of them or its value is not valid.
+bool parse_stress_option(const std::string& arg, StressConfig& config);
+
+// Returns true if every value of config is one parse_stress_option accepts.
+bool is_valid_stress_config(const StressConfig& config);
+
+// Usage of the options parse_stress_option takes.
+extern const char* const STRESS_OPTIONS_USAGE;
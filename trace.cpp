@@ -0,0 +1,191 @@
+#include "trace.h"
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+
+enum class EventType : char {
+    Begin = 'B',
+    End = 'E',
+    Counter = 'C'
+};
+
+struct TraceEvent {
+    int64_t time; // nanoseconds since Tracer::enable
+    int64_t value; // counters only
+    const char* name;
+    EventType type;
+};
+
+// Events of one thread at a time. Only the owning thread writes, so appending is a store and a release
+// increment, and the writer reads it after the thread stopped.
+struct TraceRing {
+    std::atomic<bool> in_use{false};
+    std::atomic<uint64_t> head{0}; // events recorded, including overwritten ones
+    std::unique_ptr<TraceEvent[]> events;
+    const char* name = nullptr;
+
+    void push(EventType type, const char* event_name, int64_t value);
+};
+
+static std::array<TraceRing, Tracer::MAX_THREADS> rings;
+static std::chrono::steady_clock::time_point start_time;
+
+// Gives the ring of a thread back when the thread ends
+struct RingHandle {
+    TraceRing* ring = nullptr;
+    bool claimed = false; // tried to claim a ring (it stays null if none was free)
+
+    ~RingHandle()
+    {
+        if (ring != nullptr) {
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local RingHandle ring_handle;
+
+// Returns the ring of the calling thread, claiming a free one on its first event. Null if none is free.
+static TraceRing* get_ring()
+{
+    if (ring_handle.claimed) {
+        return ring_handle.ring;
+    }
+    ring_handle.claimed = true;
+    for (TraceRing& ring : rings) {
+        bool free = false;
+        if (ring.in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+            if (!ring.events) {
+                ring.events.reset(new TraceEvent[Tracer::MAX_EVENTS]);
+            }
+            ring_handle.ring = &ring;
+            break;
+        }
+    }
+    return ring_handle.ring;
+}
+
+void TraceRing::push(EventType type, const char* event_name, int64_t value)
+{
+    uint64_t index = head.load(std::memory_order_relaxed);
+    TraceEvent& event = events[index & (Tracer::MAX_EVENTS - 1)];
+    event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+    event.value = value;
+    event.name = event_name;
+    event.type = type;
+    head.store(index + 1, std::memory_order_release);
+}
+
+static void record(EventType type, const char* name, int64_t value = 0)
+{
+    TraceRing* ring = get_ring();
+    if (ring != nullptr) {
+        ring->push(type, name, value);
+    }
+}
+
+// Writes str as a JSON string. Names are literals, so only quotes and backslashes are escaped.
+static void write_string(std::ostream& os, const char* str)
+{
+    os << '"';
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            os << '\\';
+        }
+        os << *str;
+    }
+    os << '"';
+}
+
+std::atomic<bool> Tracer::enabled(false);
+
+void Tracer::enable()
+{
+    start_time = std::chrono::steady_clock::now();
+    enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::set_thread_name(const char* name)
+{
+    if (!is_enabled()) {
+        return;
+    }
+    TraceRing* ring = get_ring();
+    if (ring != nullptr) {
+        ring->name = name;
+    }
+}
+
+void Tracer::begin(const char* name)
+{
+    if (is_enabled()) {
+        record(EventType::Begin, name);
+    }
+}
+
+void Tracer::end(const char* name)
+{
+    if (is_enabled()) {
+        record(EventType::End, name);
+    }
+}
+
+void Tracer::counter(const char* name, int64_t value)
+{
+    if (is_enabled()) {
+        record(EventType::Counter, name, value);
+    }
+}
+
+void Tracer::write(std::ostream& os)
+{
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    os << std::fixed << std::setprecision(3);
+    for (size_t tid = 0; tid < rings.size(); tid++) {
+        const TraceRing& ring = rings[tid];
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        if (head == 0) {
+            continue;
+        }
+        if (ring.name != nullptr) {
+            os << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+            write_string(os, ring.name);
+            os << "}}";
+            first = false;
+        }
+        // If the ring wrapped, the slices begun before its oldest event have ends without beginnings: skip them
+        int depth = 0;
+        for (uint64_t i = head > MAX_EVENTS ? head - MAX_EVENTS : 0; i < head; i++) {
+            const TraceEvent& event = ring.events[i & (MAX_EVENTS - 1)];
+            if (event.type == EventType::Begin) {
+                depth++;
+            } else if (event.type == EventType::End) {
+                if (depth == 0) {
+                    continue;
+                }
+                depth--;
+            }
+            os << (first ? "" : ",") << "\n{\"ph\":\"" << static_cast<char>(event.type) << "\",\"name\":";
+            write_string(os, event.name);
+            os << ",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << event.time / 1000.0;
+            if (event.type == EventType::Counter) {
+                os << ",\"args\":{\"value\":" << event.value << "}";
+            }
+            os << "}";
+            first = false;
+        }
+    }
+    os << "\n]}\n";
+}
+
+bool Tracer::write(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    write(out);
+    return static_cast<bool>(out);
+}
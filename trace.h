@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Timeline of what every thread did, written as a Chrome trace (trace event JSON, opened by chrome://tracing
+// or ui.perfetto.dev) to see which frame and which phase of it spiked. Off unless enabled, when recording
+// is a relaxed load.
+//
+// Each thread records its events into its own ring of MAX_EVENTS, so recording never locks or waits for
+// another thread, and a ring that is full overwrites its oldest events (the trace keeps the last minutes).
+// A ring is given back when its thread ends, and reused by the next one (e.g. the simulation thread of the
+// next round), so it shows as one track.
+class Tracer {
+    public:
+        // Per thread, a power of two
+        static constexpr size_t MAX_EVENTS = 1 << 17;
+        // Threads recording at the same time. Events of further ones are dropped.
+        static constexpr size_t MAX_THREADS = 16;
+
+        // Starts recording. Call it before starting the threads to trace.
+        static void enable();
+        static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+        // Names the track of the calling thread. name must outlive the tracer (a literal).
+        static void set_thread_name(const char* name);
+        // Begins and ends a slice of the calling thread. Slices must nest. name must outlive the tracer.
+        static void begin(const char* name);
+        static void end(const char* name);
+        // Sets the value of a counter, drawn as a graph over time.
+        static void counter(const char* name, int64_t value);
+
+        // Writes the events recorded as a JSON trace. The traced threads must have stopped (or be idle).
+        static void write(std::ostream& os);
+        // Writes the trace to path. Returns false if it could not be written.
+        static bool write(const std::string& path);
+
+    private:
+        static std::atomic<bool> enabled;
+};
+
+// Records a slice of the calling thread for as long as it lives, if the tracer is enabled.
+class TraceScope {
+    const char* name;
+    bool recording;
+
+    public:
+        explicit TraceScope(const char* name) : name(name), recording(Tracer::is_enabled())
+        {
+            if (recording) {
+                Tracer::begin(name);
+            }
+        }
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+        ~TraceScope()
+        {
+            if (recording) {
+                Tracer::end(name);
+            }
+        }
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one writer thread to one reader thread without locks. Three values are
+// kept: the writer fills the back one and publishes it by swapping it with the middle one, and the
+// reader swaps the middle one with its front one when the middle one is newer. Neither thread ever
+// waits for the other and the reader always sees a whole value, but values published faster than the
+// reader picks them up are skipped.
+template <typename T>
+class TripleBuffer {
+    // Set in middle while it holds a value the reader has not taken yet
+    static constexpr uint8_t FRESH = 4;
+
+    T values[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t back = 0;  // only used by the writer
+    uint8_t front = 2; // only used by the reader
+
+    public:
+        // Returns the value to fill before publish(). Writer thread only.
+        T& get_back()
+        {
+            return values[back];
+        }
+
+        // Makes the back value the latest one, and gives the writer another one to fill. Writer thread only.
+        void publish()
+        {
+            back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+        }
+
+        // Takes the latest published value if the front one is older. Returns true if it did. Reader thread only.
+        bool update_front()
+        {
+            if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+                return false;
+            }
+            front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+            return true;
+        }
+
+        // Returns the value last taken by update_front(). Reader thread only.
+        const T& get_front() const
+        {
+            return values[front];
+        }
+};
@@ -1,138 +1,10 @@
 #include "util.h"
 
-Vector2::Vector2(double x, double y): x(x), y(y) {}
-
-double Vector2::getX() const {
-    return x;
-}
-
-double Vector2::getY() const {
-    return y;
-}
-
-int Vector2::get_rounded_x() const
-{
-    if (x - int(x) >= 0.5) {
-        return int(x) + 1;
-    }
-    return int(x);
-}
-
-int Vector2::get_rounded_y() const
-{
-    if (y - int(y) >= 0.5) {
-        return int(y);
-    }
-    return int(y) + 1;
-}
-
-double Vector2::get_magnitude() const
-{
-    return sqrt(x * x + y * y);
-}
-
-void Vector2::setX(double x) {
-    this->x = x;
-}
-void Vector2::setY(double y) {
-    this->y = y;
-}
-Vector2 Vector2::operator+(const Vector2& v) {
-    Vector2 temp = *this;
-    return temp += v;
-}
-double Vector2::dot(const Vector2 &v)
-{
-    return getX() * v.getX() + getY() * v.getY();
-}
-Vector2 Vector2::normalise()
-{
-    Vector2 temp(*this);
-    double magnitude = get_magnitude();
-    temp.setX(x / magnitude);
-    temp.setY(y / magnitude);
-    return temp;
-}
-Vector2 Vector2::operator-(const Vector2 &v)
-{
-    Vector2 temp = *this;
-    return temp -= v;
-}
-Vector2 Vector2::operator-()
-{
-    return Vector2(-x, -y);
-}
-Vector2 Vector2::operator*(const double &d)
-{
-    Vector2 temp = *this;
-    return temp *= d;
-}
-Vector2 Vector2::operator/(const double &d)
-{
-    Vector2 temp = *this;
-    return temp /= d;
-}
-Vector2 &Vector2::operator+=(const Vector2 &v)
-{
-    x += v.x;
-    y += v.y;
-    return *this;
-}
-Vector2& Vector2::operator-=(const Vector2& v) {
-    x -= v.x;
-    y -= v.y;
-    return *this;
-}
-
-Vector2 &Vector2::operator*=(const double &d)
-{
-    x *= d;
-    y *= d;
-    return *this;
-}
-
-Vector2 &Vector2::operator/=(const double &d)
-{
-    x /= d;
-    y /= d;
-    return *this;
-}
-
 std::string Vector2::to_string() const
 {
     return "(" + std::to_string(x) + ", " + std::to_string(y) + ")";
 }
 
-Position::Position(double x, double y): Vector2(x, y) {
-    add_vector2_to_position_bound(Vector2(0,0)); // make sure within bounds
-}
-
-Vector2 &Position::add_vector2_to_position_bound(const Vector2 &v)
-{
-    *this += v;
-    if (getX() >= MAX_X) {
-        setX(MAX_X);
-    } else if (getX() <= 0) {
-        setX(0);
-    }
-    if (getY() >= MAX_Y) {
-        setY(MAX_Y);
-    } else if (getY() <= 0) {
-        setY(0);
-    }
-    return *this;
-}
-
-bool operator==(const Vector2 &v1, const Vector2 &v2)
-{
-    return abs(v1.getX() - v2.getX()) <= std::numeric_limits<double>::epsilon() && abs(v1.getY() - v2.getY()) <= std::numeric_limits<double>::epsilon();
-}
-
-bool operator!=(const Vector2 &v1, const Vector2 &v2)
-{
-    return !(v1 == v2);
-}
-
 std::ostream &operator<<(std::ostream &os, const Vector2 &v)
 {
     return os << '(' << v.getX() << ", " << v.getY() << ')';
@@ -156,6 +28,44 @@ void Rect::set(const Vector2& topL, const Vector2& topR, const Vector2& bottomL,
     area = (edge_points[1].getX() - edge_points[0].getX()) * (edge_points[1].getY() - edge_points[2].getY());
 }
 
+float proportion_intersected(const Aabb& box, const Aabb& other)
+{
+    // Same arithmetic as Rect::proportion_intersected, with box as this rect
+    float area = (box.max_x - box.min_x) * (box.max_y - box.min_y);
+    float x_overlap = std::max(box.min_x, other.min_x) - std::min(box.max_x, other.max_x);
+    float y_overlap = std::max(box.max_y, other.max_y) - std::min(box.min_y, other.min_y);
+    float area_overlap = x_overlap * y_overlap;
+
+    return area_overlap / area;
+}
+
+// Narrows [t_enter, t_exit] to the times at which [min, max] moving by d overlaps [other_min, other_max].
+static void clip_time_of_impact(double min, double max, double d, double other_min, double other_max, double& t_enter, double& t_exit)
+{
+    if (d == 0) {
+        if (max < other_min || min > other_max) {
+            t_enter = 1;
+            t_exit = 0;
+        }
+        return;
+    }
+    double t0 = (other_min - max) / d;
+    double t1 = (other_max - min) / d;
+    if (t0 > t1) {
+        std::swap(t0, t1);
+    }
+    t_enter = std::max(t_enter, t0);
+    t_exit = std::min(t_exit, t1);
+}
+
+double get_time_of_impact(const Aabb& box, double dx, double dy, const Aabb& other)
+{
+    double t_enter = 0, t_exit = 1;
+    clip_time_of_impact(box.min_x, box.max_x, dx, other.min_x, other.max_x, t_enter, t_exit);
+    clip_time_of_impact(box.min_y, box.max_y, dy, other.min_y, other.max_y, t_enter, t_exit);
+    return t_enter <= t_exit ? t_enter : -1;
+}
+
 float Rect::proportion_intersected(const Rect &rect) const
 {
     // max of left for this and other rect - min of right for this and other rect
@@ -168,11 +78,17 @@ float Rect::proportion_intersected(const Rect &rect) const
     return area_overlap / area;
 }
 
-std::array<Vector2, 4> Rect::get_edge_points() const
+const std::array<Vector2, 4>& Rect::get_edge_points() const
 {
     return edge_points;
 }
 
+Aabb Rect::get_bounds() const
+{
+    // edge points: 0 = topL, 1 = topR, 2 = bottomL, 3 = bottomR
+    return { edge_points[0].getX(), edge_points[2].getY(), edge_points[1].getX(), edge_points[0].getY() };
+}
+
 std::string Rect::to_string() const
 {
     std::string s = "[";
@@ -185,44 +101,75 @@ std::string Rect::to_string() const
     return s;
 }
 
-bool is_in_bounds(int x, int y)
+bool is_in_view(int x, int y)
 {
     return (x >= 0 && x <= MAX_X) && (y >= 0 && y <= MAX_Y);
 }
 
-bool is_in_bounds(const Vector2& pos) {
-    return is_in_bounds(pos.getX(), pos.getY());
+bool is_in_bounds(int x, int y, const WorldSize& world)
+{
+    return (x >= 0 && x <= world.width) && (y >= 0 && y <= world.height);
+}
+
+bool is_in_bounds(const Vector2& pos, const WorldSize& world) {
+    return is_in_bounds(pos.getX(), pos.getY(), world);
+}
+
+bool is_in_bounds(const Rect& rect, const WorldSize& world)
+{
+    return is_in_bounds(rect.get_bounds(), world);
+}
+
+bool is_in_bounds(const Aabb& box, const WorldSize& world)
+{
+    return is_in_bounds(Vector2(box.min_x, box.max_y), world) || is_in_bounds(Vector2(box.max_x, box.max_y), world) ||
+        is_in_bounds(Vector2(box.min_x, box.min_y), world) || is_in_bounds(Vector2(box.max_x, box.min_y), world);
+}
+
+// The sides are boxes just outside the space. Their bounds are given the way Rect::get_bounds
+// read the corners of the Rects they used to be, which has min and max swapped on y.
+bool is_touching_space_bottom_side(const Aabb& box, const WorldSize& world)
+{
+    const Aabb bottom_box = { 0, world.height + 5, world.width, world.height };
+    return proportion_intersected(bottom_box, box) == 0;
+}
+
+bool is_touching_space_left_side(const Aabb& box, const WorldSize& world)
+{
+    const Aabb left_box = { -5, world.height, 0, 0 };
+    return proportion_intersected(left_box, box) == 0;
+}
+
+bool is_touching_space_right_side(const Aabb& box, const WorldSize& world)
+{
+    const Aabb right_box = { world.width, world.height, world.width + 5, 0 };
+    return proportion_intersected(right_box, box) == 0;
 }
 
-bool is_in_bounds(Rect rect)
+bool is_touching_space_top_side(const Aabb& box, const WorldSize& world)
 {
-    std::array<Vector2, 4> edge_points = rect.get_edge_points();
-    return is_in_bounds(edge_points[0]) || is_in_bounds(edge_points[1]) ||
-        is_in_bounds(edge_points[2]) || is_in_bounds(edge_points[3]);
+    const Aabb top_box = { 0, 0, world.width, -5 };
+    return proportion_intersected(top_box, box) == 0;
 }
 
-bool is_touching_space_bottom_side(const Rect &rect)
+bool is_touching_space_bottom_side(const Rect& rect, const WorldSize& world)
 {
-    static Rect bottom_rect({0, MAX_Y}, {MAX_X, MAX_Y}, {0, MAX_Y + 5}, {MAX_X, MAX_Y + 5});
-    return bottom_rect.proportion_intersected(rect) == 0;
+    return is_touching_space_bottom_side(rect.get_bounds(), world);
 }
 
-bool is_touching_space_left_side(const Rect &rect)
+bool is_touching_space_left_side(const Rect& rect, const WorldSize& world)
 {
-    static Rect left_rect({-5, 0}, {0, 0}, {-5, MAX_Y}, {0, MAX_Y});
-    return left_rect.proportion_intersected(rect) == 0;
+    return is_touching_space_left_side(rect.get_bounds(), world);
 }
 
-bool is_touching_space_right_side(const Rect &rect)
+bool is_touching_space_right_side(const Rect& rect, const WorldSize& world)
 {
-    static Rect right_rect({MAX_X, 0}, {MAX_X + 5, 0}, {MAX_X, MAX_Y}, {MAX_X + 5, MAX_Y});
-    return right_rect.proportion_intersected(rect) == 0;
+    return is_touching_space_right_side(rect.get_bounds(), world);
 }
 
-bool is_touching_space_top_side(const Rect &rect)
+bool is_touching_space_top_side(const Rect& rect, const WorldSize& world)
 {
-    static Rect top_rect({0, -5}, {MAX_X, -5}, {0, 0}, {MAX_X, 0});
-    return top_rect.proportion_intersected(rect) == 0;
+    return is_touching_space_top_side(rect.get_bounds(), world);
 }
 
 Direction get_final_direction(const std::vector<Direction>& directions) {
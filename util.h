@@ -6,60 +6,164 @@
 #include <set>
 #include <algorithm>
 #include <limits>
+#include <type_traits>
+#include <cmath>
 #include "math.h"
 
+// Size of the view: the play area drawn in the terminal
 constexpr double MAX_X = 100.0;
 constexpr double MAX_Y = 50.0;
 constexpr double MILLION = 1000000.0;
+// Length of a simulation tick, in microseconds. GameSpace simulates the time it is given in ticks of this length.
+constexpr long PHYSICS_TICK_TIME = 1000000 / 60;
 constexpr double SQRT2 = 1.4142135;
 constexpr double ONE_OVER_SQRT2 = 1/SQRT2;
 
 class GameObject;
+
+// Unique id of a GameObject, assigned when it is added to a GameSpace.
+using EntityId = unsigned int;
+
+// Precision of Vector2. Build with -DCOMPACT_MATH (e.g. make OPTFLAGS=-DCOMPACT_MATH) for floats,
+// which halves the size of every vector, Rect and GameObjectFrameInfo.
+#ifdef COMPACT_MATH
+using real = float;
+#else
+using real = double;
+#endif
+
+// Plain 2D vector. No virtual functions and everything inline, so it is trivially copyable and the
+// compiler can keep it in registers.
 class Vector2 {
     private:
-        double x;
-        double y;
+        real x;
+        real y;
     
     public:
-        Vector2(double x = 0, double y = 0);
-        virtual double getX() const;
-        virtual double getY() const;
-        int get_rounded_x() const;
-        int get_rounded_y() const;
-        double get_magnitude() const;
-        void setX(double x);
-        void setY(double y);
-
-        double dot(const Vector2& v);
-        Vector2 normalise();
-
-        Vector2 operator+(const Vector2& v);
-        Vector2 operator-();
-        Vector2 operator-(const Vector2& v);
-        Vector2 operator*(const double& d);
-        Vector2 operator/(const double& d);
-        Vector2& operator+=(const Vector2& v);
-        Vector2& operator-=(const Vector2& v);
-        Vector2& operator*=(const double& d);
-        Vector2& operator/=(const double& d);
+        constexpr Vector2(real x = 0, real y = 0) : x(x), y(y) {}
+        constexpr real getX() const { return x; }
+        constexpr real getY() const { return y; }
+        int get_rounded_x() const
+        {
+            if (x - int(x) >= 0.5) {
+                return int(x) + 1;
+            }
+            return int(x);
+        }
+        int get_rounded_y() const
+        {
+            if (y - int(y) >= 0.5) {
+                return int(y);
+            }
+            return int(y) + 1;
+        }
+        real get_magnitude() const { return std::sqrt(x * x + y * y); }
+        void setX(real x) { this->x = x; }
+        void setY(real y) { this->y = y; }
+
+        constexpr real dot(const Vector2& v) const { return x * v.x + y * v.y; }
+        Vector2 normalise() const
+        {
+            real magnitude = get_magnitude();
+            return Vector2(x / magnitude, y / magnitude);
+        }
+
+        constexpr Vector2 operator+(const Vector2& v) const { return Vector2(x + v.x, y + v.y); }
+        constexpr Vector2 operator-() const { return Vector2(-x, -y); }
+        constexpr Vector2 operator-(const Vector2& v) const { return Vector2(x - v.x, y - v.y); }
+        constexpr Vector2 operator*(real d) const { return Vector2(x * d, y * d); }
+        constexpr Vector2 operator/(real d) const { return Vector2(x / d, y / d); }
+        Vector2& operator+=(const Vector2& v)
+        {
+            x += v.x;
+            y += v.y;
+            return *this;
+        }
+        Vector2& operator-=(const Vector2& v)
+        {
+            x -= v.x;
+            y -= v.y;
+            return *this;
+        }
+        Vector2& operator*=(real d)
+        {
+            x *= d;
+            y *= d;
+            return *this;
+        }
+        Vector2& operator/=(real d)
+        {
+            x /= d;
+            y /= d;
+            return *this;
+        }
 
         std::string to_string() const;
 };
 
-bool operator==(const Vector2& v1, const Vector2& v2);
-bool operator!=(const Vector2& v1, const Vector2& v2);
+static_assert(std::is_trivially_copyable<Vector2>::value && std::is_standard_layout<Vector2>::value, "Vector2 must stay a plain value type");
 
+inline bool operator==(const Vector2& v1, const Vector2& v2)
+{
+    return std::abs(v1.getX() - v2.getX()) <= std::numeric_limits<real>::epsilon() && std::abs(v1.getY() - v2.getY()) <= std::numeric_limits<real>::epsilon();
+}
 
-const Vector2 GRAVITY(0, 9.81);
+inline bool operator!=(const Vector2& v1, const Vector2& v2)
+{
+    return !(v1 == v2);
+}
 
-class Position : public Vector2 {
-    public:
-        Position(double x = 0, double y = 0);
-        Vector2& add_vector2_to_position_bound(const Vector2& v);
+
+constexpr Vector2 GRAVITY(0, 9.81);
+
+// A point in the space. Positions are plain vectors: keeping one inside the space is done with
+// bound_to_space, where it is needed.
+using Position = Vector2;
+
+// Size of the space entities live in: the view (MAX_X by MAX_Y) unless it is larger, in which case the
+// view follows the player around it (see GameSpace::set_world). Neither side is smaller than the view.
+struct WorldSize {
+    double width = MAX_X;
+    double height = MAX_Y;
+
+    WorldSize() = default;
+    WorldSize(double width, double height) : width(std::max(width, MAX_X)), height(std::max(height, MAX_Y)) {}
 };
 
+// Returns position clamped to [0, world width] x [0, world height].
+inline Vector2 bound_to_space(const Vector2& position, const WorldSize& world)
+{
+    return Vector2(position.getX() >= world.width ? world.width : position.getX() <= 0 ? 0 : position.getX(),
+        position.getY() >= world.height ? world.height : position.getY() <= 0 ? 0 : position.getY());
+}
+
+// Adds v to position, then clamps it to the world. Returns position.
+inline Vector2& add_vector2_to_position_bound(Vector2& position, const Vector2& v, const WorldSize& world)
+{
+    position = bound_to_space(position + v, world);
+    return position;
+}
+
 std::ostream& operator<<(std::ostream& os, const Vector2& v);
 
+// Axis aligned bounding box. Top has the larger y, like Rect.
+struct Aabb {
+    double min_x, min_y, max_x, max_y;
+};
+
+// Returns true if a and b overlap. Edges are inclusive, like HitBox::intersects.
+inline bool aabbs_overlap(const Aabb& a, const Aabb& b)
+{
+    return a.min_x <= b.max_x && a.max_x >= b.min_x && a.max_y >= b.min_y && a.min_y <= b.max_y;
+}
+
+// Returns the earliest time in [0, 1] at which box, moving by (dx, dy) over the time, touches other, or
+// a negative value if it does not. Swept test on each axis: box touches other while both axes overlap.
+double get_time_of_impact(const Aabb& box, double dx, double dy, const Aabb& other);
+
+// Same as Rect::proportion_intersected, for bounding boxes.
+float proportion_intersected(const Aabb& box, const Aabb& other);
+
 class Rect {
     std::array<Vector2, 4> edge_points;
     float area;
@@ -67,23 +171,35 @@ class Rect {
         Rect(Vector2 topL = Vector2(0,0), Vector2 topR = Vector2(0,0), Vector2 bottomL = Vector2(0,0), Vector2 bottomR = Vector2(0,0));
         void set(const Vector2& topL, const Vector2& topR, const Vector2& bottomL, const Vector2& bottomR);
         float proportion_intersected(const Rect& rect) const;
-        std::array<Vector2, 4> get_edge_points() const;
+        const std::array<Vector2, 4>& get_edge_points() const;
+        // Returns the left and right of the top edge, the bottom of the left edge and the top of the left edge.
+        Aabb get_bounds() const;
         std::string to_string() const;
 };
 
 std::ostream& operator<<(std::ostream& os, const Rect& r);
 
-bool is_in_bounds(int x, int y);
+// Returns true if (x, y) is in the view, e.g. a cell of the frame buffer.
+bool is_in_view(int x, int y);
+
+// The is_in_bounds functions test against the world.
+bool is_in_bounds(int x, int y, const WorldSize& world);
 
-bool is_in_bounds(const Vector2& pos);
+bool is_in_bounds(const Vector2& pos, const WorldSize& world);
 
-bool is_in_bounds(Rect rect);
+bool is_in_bounds(const Rect& rect, const WorldSize& world);
+// Returns true if any corner of box is in bounds.
+bool is_in_bounds(const Aabb& box, const WorldSize& world);
 
-// Referring to sides of GameSpace
-bool is_touching_space_bottom_side(const Rect& rect);
-bool is_touching_space_left_side(const Rect& rect);
-bool is_touching_space_right_side(const Rect& rect);
-bool is_touching_space_top_side(const Rect& rect);
+// Referring to sides of the world
+bool is_touching_space_bottom_side(const Rect& rect, const WorldSize& world);
+bool is_touching_space_left_side(const Rect& rect, const WorldSize& world);
+bool is_touching_space_right_side(const Rect& rect, const WorldSize& world);
+bool is_touching_space_top_side(const Rect& rect, const WorldSize& world);
+bool is_touching_space_bottom_side(const Aabb& box, const WorldSize& world);
+bool is_touching_space_left_side(const Aabb& box, const WorldSize& world);
+bool is_touching_space_right_side(const Aabb& box, const WorldSize& world);
+bool is_touching_space_top_side(const Aabb& box, const WorldSize& world);
 
 enum class Direction {
     Up = -3,
@@ -0,0 +1,71 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(size_t num_threads)
+{
+    for (size_t worker = 1; worker < num_threads; worker++) {
+        threads.push_back(std::thread(&WorkerPool::worker_loop, this, worker));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::worker_loop(size_t worker)
+{
+    unsigned long seen_generation = 0;
+    while (true) {
+        const std::function<void(size_t)>* current_job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [&]() { return stopping || generation != seen_generation; });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+            current_job = job;
+        }
+
+        (*current_job)(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            num_pending--;
+        }
+        work_done.notify_one();
+    }
+}
+
+void WorkerPool::run(const std::function<void(size_t)>& job)
+{
+    if (threads.empty()) {
+        job(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        num_pending = threads.size();
+        generation++;
+    }
+    work_ready.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this]() { return num_pending == 0; });
+    this->job = nullptr;
+}
+
+size_t WorkerPool::get_num_threads() const
+{
+    return threads.size() + 1;
+}
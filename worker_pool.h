@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed set of worker threads that all run the same job, each with its own worker number.
+// The calling thread takes part as worker 0, so a pool of 1 runs jobs inline without any thread.
+class WorkerPool {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    const std::function<void(size_t)>* job = nullptr;
+    unsigned long generation = 0;
+    size_t num_pending = 0;
+    bool stopping = false;
+
+    void worker_loop(size_t worker);
+
+    public:
+        explicit WorkerPool(size_t num_threads);
+        ~WorkerPool();
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // Calls job(worker) once for every worker in [0, get_num_threads()), and returns when all are done.
+        void run(const std::function<void(size_t)>& job);
+
+        size_t get_num_threads() const;
+};